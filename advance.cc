@@ -0,0 +1,182 @@
+#include "advance.hh"
+#include "rnglanes.hh"
+#include <cstring>
+#include <initializer_list>
+
+// Reference path, also used for the tail of the vector kernels. Wraps are
+// rare, so only the respawn itself is behind a branch.
+static size_t advanceScalar(float *z, uint32_t *generation, size_t begin,
+                            size_t end, float step, float limit,
+                            const Respawn &respawn, uint32_t *respawned) {
+  size_t count{0};
+  for (size_t index = begin; index < end; ++index) {
+    z[index] += step;
+    if (z[index] > limit) {
+      generation[index]++;
+      z[index] = counterUniform(respawn.key, (uint32_t)index,
+                                generation[index], respawn.zMin,
+                                respawn.zRange);
+      respawned[count++] = (uint32_t)index;
+    }
+  }
+  return count;
+}
+
+#ifdef STARFIELD_X86
+__attribute__((target("sse4.2"))) static size_t
+advanceSse42(float *z, uint32_t *generation, size_t begin, size_t end,
+             float step, float limit, const Respawn &respawn,
+             uint32_t *respawned) {
+  const __m128 vstep = _mm_set1_ps(step);
+  const __m128 vlimit = _mm_set1_ps(limit);
+  const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+  size_t count{0};
+  size_t index = begin;
+
+  for (; index + 4 <= end; index += 4) {
+    __m128 v = _mm_add_ps(_mm_loadu_ps(z + index), vstep);
+    __m128 wrap = _mm_cmpgt_ps(v, vlimit);
+    unsigned mask = _mm_movemask_ps(wrap);
+    if (mask) {
+      // the compare mask is -1 per wrapped lane, subtracting it bumps those
+      __m128i *gens = reinterpret_cast<__m128i *>(generation + index);
+      __m128i g = _mm_sub_epi32(_mm_loadu_si128(gens), _mm_castps_si128(wrap));
+      _mm_storeu_si128(gens, g);
+      __m128i ids = _mm_add_epi32(_mm_set1_epi32((int)index), lanes);
+      __m128 fresh = counterUniformSse(respawn.key, ids, g, respawn.zMin,
+                                       respawn.zRange);
+      v = _mm_blendv_ps(v, fresh, wrap);
+      while (mask) {
+        respawned[count++] = (uint32_t)(index + __builtin_ctz(mask));
+        mask &= mask - 1;
+      }
+    }
+    _mm_storeu_ps(z + index, v);
+  }
+  return count + advanceScalar(z, generation, index, end, step, limit,
+                               respawn, respawned + count);
+}
+
+__attribute__((target("avx2"))) static size_t
+advanceAvx2(float *z, uint32_t *generation, size_t begin, size_t end,
+            float step, float limit, const Respawn &respawn,
+            uint32_t *respawned) {
+  const __m256 vstep = _mm256_set1_ps(step);
+  const __m256 vlimit = _mm256_set1_ps(limit);
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  size_t count{0};
+  size_t index = begin;
+
+  for (; index + 8 <= end; index += 8) {
+    __m256 v = _mm256_add_ps(_mm256_loadu_ps(z + index), vstep);
+    __m256 wrap = _mm256_cmp_ps(v, vlimit, _CMP_GT_OQ);
+    unsigned mask = _mm256_movemask_ps(wrap);
+    if (mask) {
+      // the compare mask is -1 per wrapped lane, subtracting it bumps those
+      __m256i *gens = reinterpret_cast<__m256i *>(generation + index);
+      __m256i g = _mm256_sub_epi32(_mm256_loadu_si256(gens),
+                                   _mm256_castps_si256(wrap));
+      _mm256_storeu_si256(gens, g);
+      __m256i ids = _mm256_add_epi32(_mm256_set1_epi32((int)index), lanes);
+      __m256 fresh = counterUniformAvx2(respawn.key, ids, g, respawn.zMin,
+                                        respawn.zRange);
+      v = _mm256_blendv_ps(v, fresh, wrap);
+      while (mask) {
+        respawned[count++] = (uint32_t)(index + __builtin_ctz(mask));
+        mask &= mask - 1;
+      }
+    }
+    _mm256_storeu_ps(z + index, v);
+  }
+  return count + advanceScalar(z, generation, index, end, step, limit,
+                               respawn, respawned + count);
+}
+
+__attribute__((target("avx512f"))) static size_t
+advanceAvx512(float *z, uint32_t *generation, size_t begin, size_t end,
+              float step, float limit, const Respawn &respawn,
+              uint32_t *respawned) {
+  const __m512 vstep = _mm512_set1_ps(step);
+  const __m512 vlimit = _mm512_set1_ps(limit);
+  const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                          11, 12, 13, 14, 15);
+  size_t count{0};
+  size_t index = begin;
+
+  for (; index + 16 <= end; index += 16) {
+    __m512 v = _mm512_add_ps(_mm512_loadu_ps(z + index), vstep);
+    __mmask16 mask = _mm512_cmp_ps_mask(v, vlimit, _CMP_GT_OQ);
+    if (mask) {
+      __m512i g = _mm512_loadu_si512(generation + index);
+      g = _mm512_mask_add_epi32(g, mask, g, _mm512_set1_epi32(1));
+      _mm512_storeu_si512(generation + index, g);
+      __m512i ids = _mm512_add_epi32(_mm512_set1_epi32((int)index), lanes);
+      __m512 fresh = counterUniformAvx512(respawn.key, ids, g, respawn.zMin,
+                                          respawn.zRange);
+      v = _mm512_mask_blend_ps(mask, v, fresh);
+      // compress the wrapped lanes' indices straight into the output
+      _mm512_mask_compressstoreu_epi32(respawned + count, mask, ids);
+      count += __builtin_popcount(mask);
+    }
+    _mm512_storeu_ps(z + index, v);
+  }
+  return count + advanceScalar(z, generation, index, end, step, limit,
+                               respawn, respawned + count);
+}
+#endif
+
+SimdIsa detectSimdIsa() {
+#ifdef STARFIELD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return SimdIsa::Avx512;
+  if (__builtin_cpu_supports("avx2"))
+    return SimdIsa::Avx2;
+  if (__builtin_cpu_supports("sse4.2"))
+    return SimdIsa::Sse42;
+#endif
+  return SimdIsa::Scalar;
+}
+
+const char *simdIsaName(SimdIsa isa) {
+  switch (isa) {
+  case SimdIsa::Sse42:
+    return "sse4.2";
+  case SimdIsa::Avx2:
+    return "avx2";
+  case SimdIsa::Avx512:
+    return "avx512";
+  case SimdIsa::Scalar:
+    break;
+  }
+  return "scalar";
+}
+
+bool parseSimdIsa(const char *name, SimdIsa &isa) {
+  for (SimdIsa candidate : {SimdIsa::Scalar, SimdIsa::Sse42, SimdIsa::Avx2,
+                            SimdIsa::Avx512}) {
+    if (std::strcmp(name, simdIsaName(candidate)) == 0) {
+      isa = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+AdvanceKernel selectAdvanceKernel(SimdIsa isa) {
+#ifdef STARFIELD_X86
+  switch (isa) {
+  case SimdIsa::Avx512:
+    return advanceAvx512;
+  case SimdIsa::Avx2:
+    return advanceAvx2;
+  case SimdIsa::Sse42:
+    return advanceSse42;
+  case SimdIsa::Scalar:
+    break;
+  }
+#else
+  (void)isa;
+#endif
+  return advanceScalar;
+}
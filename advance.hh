@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+enum class SimdIsa { Scalar, Sse42, Avx2, Avx512 };
+
+// Widest instruction set both compiled in and supported by this CPU.
+SimdIsa detectSimdIsa();
+const char *simdIsaName(SimdIsa isa);
+// Parses the names returned by simdIsaName, returns false when unknown.
+bool parseSimdIsa(const char *name, SimdIsa &isa);
+
+// Where a star past the limit comes back: z is drawn from the counter RNG
+// (see rng.hh) keyed by key, uniform in [zMin, zMin + zRange).
+struct Respawn {
+  uint32_t key;
+  float zMin;
+  float zRange;
+};
+
+// Adds step to z[begin, end). Every star that ends up past limit gets its
+// generation bumped and a new z from respawn, computed inside the vector
+// lanes and blended in under the wrap mask. The indices of respawned stars
+// are also written to respawned (room for end - begin entries) for callers
+// that patch per star data; the return value is how many were written.
+using AdvanceKernel = size_t (*)(float *z, uint32_t *generation, size_t begin,
+                                 size_t end, float step, float limit,
+                                 const Respawn &respawn, uint32_t *respawned);
+
+AdvanceKernel selectAdvanceKernel(SimdIsa isa);
@@ -0,0 +1,84 @@
+#include "bench.hh"
+#include <algorithm>
+#include <numeric>
+
+const char *BenchRecorder::metricName(Metric metric) {
+  switch (metric) {
+  case Frame:
+    return "frame";
+  case Update:
+    return "update";
+  case Build:
+    return "build";
+  case Upload:
+    return "upload";
+  case Draw:
+    return "draw";
+  case METRICS:
+    break;
+  }
+  return "unknown";
+}
+
+// nearest rank on sorted, which holds at least one sample
+static float percentile(const std::vector<float> &sorted, float rank) {
+  size_t index = (size_t)(rank / 100.0f * sorted.size() + 0.5f);
+  return sorted[std::clamp<size_t>(index, 1, sorted.size()) - 1];
+}
+
+static void writeString(std::ostream &out, const std::string &text) {
+  out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      out << '\\';
+    out << c;
+  }
+  out << '"';
+}
+
+void BenchRecorder::writeJson(
+    std::ostream &out,
+    const std::vector<std::pair<std::string, std::string>> &settings) const {
+  out << "{\"settings\":{";
+  for (size_t index = 0; index < settings.size(); ++index) {
+    if (index > 0)
+      out << ',';
+    writeString(out, settings[index].first);
+    out << ':';
+    writeString(out, settings[index].second);
+  }
+  out << "},\"frames\":" << samples[Frame].size() << ",\"ms\":{";
+
+  bool first = true;
+  for (int metric = 0; metric < METRICS; ++metric) {
+    if (samples[metric].empty())
+      continue;
+    std::vector<float> sorted = samples[metric];
+    std::sort(sorted.begin(), sorted.end());
+    float mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) /
+                 sorted.size();
+    if (!first)
+      out << ',';
+    first = false;
+    out << '"' << metricName((Metric)metric) << "\":{\"p50\":"
+        << percentile(sorted, 50.0f) << ",\"p95\":" << percentile(sorted, 95.0f)
+        << ",\"p99\":" << percentile(sorted, 99.0f)
+        << ",\"max\":" << sorted.back() << ",\"mean\":" << mean << '}';
+  }
+  out << "},\"samples\":{";
+
+  // every measured frame as is, for tools that compare whole distributions
+  first = true;
+  for (int metric = 0; metric < METRICS; ++metric) {
+    if (samples[metric].empty())
+      continue;
+    if (!first)
+      out << ',';
+    first = false;
+    out << '"' << metricName((Metric)metric) << "\":[";
+    for (size_t index = 0; index < samples[metric].size(); ++index)
+      out << (index > 0 ? "," : "") << samples[metric][index];
+    out << ']';
+  }
+  out << "}}" << std::endl;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Per frame timings of a --bench run, summarised as percentiles. Each
+// metric only shows up in the report if it got samples, so a GPU backend
+// reports no instance build and a run without timer queries no draw time.
+class BenchRecorder {
+public:
+  enum Metric {
+    Frame,  // wall time from the start of one frame to the next
+    Update, // CPU: advancing the stars, summed over job threads
+    Build,  // CPU: packing instances, summed over job threads
+    Upload, // CPU: getting instances into the GL buffer
+    Draw,   // GPU: the star draw, from timer queries
+    METRICS
+  };
+
+  // Frames run before measuring, for caches, drivers and clocks to settle.
+  static constexpr int WARMUP = 30;
+
+  static const char *metricName(Metric metric);
+
+  void add(Metric metric, float ms) { samples[metric].push_back(ms); }
+
+  // Writes one line of JSON: settings as given, then frames, per metric
+  // p50/p95/p99/max/mean in milliseconds and last every sample in the order
+  // they were taken.
+  void writeJson(
+      std::ostream &out,
+      const std::vector<std::pair<std::string, std::string>> &settings) const;
+
+private:
+  std::vector<float> samples[METRICS];
+};
@@ -0,0 +1,29 @@
+#include "budget.hh"
+#include <algorithm>
+
+StarBudget::StarBudget(float targetMs, size_t minStars, size_t maxStars)
+    : target(targetMs), minStars(minStars), maxStars(maxStars) {}
+
+size_t StarBudget::update(size_t stars, float cpuMs, float gpuMs) {
+  float cost = std::max(cpuMs, 0.0f) + std::max(gpuMs, 0.0f);
+  smoothed = smoothed < 0.0f ? cost : smoothed + (cost - smoothed) * SMOOTHING;
+
+  if (settle > 0) {
+    settle--;
+    return stars;
+  }
+  if (smoothed >= target * GROW_BELOW && smoothed <= target * SHRINK_ABOVE)
+    return stars;
+
+  // cost is roughly linear in the star count, aim for the middle of the band
+  // and never jump more than a factor of two per step
+  float scale = target * (GROW_BELOW + SHRINK_ABOVE) * 0.5f /
+                std::max(smoothed, 0.01f);
+  scale = std::clamp(scale, 0.5f, 2.0f);
+  size_t next = std::clamp((size_t)(stars * scale), minStars, maxStars);
+  if (next != stars) {
+    settle = SETTLE_FRAMES;
+    smoothed = -1.0f;
+  }
+  return next;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+
+// Picks the number of stars to draw so the per-frame cost that scales with
+// the star count (CPU simulation plus GPU draw time) stays near a budget.
+// Costs are smoothed, nothing changes inside a dead band around the target
+// and every change is followed by a few frames of settling, so the count
+// doesn't oscillate on noisy frames or on timer results that lag behind.
+class StarBudget {
+public:
+  StarBudget(float targetMs, size_t minStars, size_t maxStars);
+
+  // Feed one frame's cost, returns the star count to use from now on.
+  size_t update(size_t stars, float cpuMs, float gpuMs);
+
+  float smoothedMs() const { return smoothed; }
+
+private:
+  static constexpr float SMOOTHING = 0.1f;
+  static constexpr float GROW_BELOW = 0.8f;   // of target
+  static constexpr float SHRINK_ABOVE = 1.05f; // of target
+  static constexpr int SETTLE_FRAMES = 30;
+
+  float target;
+  size_t minStars;
+  size_t maxStars;
+  float smoothed{-1.0f};
+  int settle{SETTLE_FRAMES};
+};
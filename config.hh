@@ -0,0 +1,11 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+constexpr int32_t SCREEN_WIDTH = 1600;
+constexpr int32_t SCREEN_HEIGHT = 1100;
+constexpr float fov = glm::radians(90.0f);
+inline const float zFar = (SCREEN_WIDTH / 2.0) / tanf64(fov / 2.0f);
+// star speed in world units per second, one unit per frame at 60Hz
+constexpr float STAR_SPEED = 60.0f;
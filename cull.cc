@@ -0,0 +1,164 @@
+// clang-format off
+#include "khrplatform.h"
+#include "glad.h"
+// clang-format on
+#include "cull.hh"
+#include "config.hh"
+#include "gpusim.hh"
+#include "instance.hh"
+#include <cmath>
+
+struct DrawArraysIndirectCommand {
+  uint32_t count;
+  uint32_t instanceCount;
+  uint32_t first;
+  uint32_t baseInstance;
+};
+
+// Each work group counts its visible stars in shared memory and reserves
+// room for all of them with a single atomic on the command, so the global
+// counter sees one atomic per 256 stars instead of one per star.
+static const char *const cullShaderSource = R"(
+#version 430 core
+layout (local_size_x = 256) in;
+
+struct Star {
+    vec3 position;
+    uint generation;
+};
+
+layout (std430, binding = 0) readonly buffer Stars {
+    Star stars[];
+};
+
+layout (std430, binding = 1) writeonly buffer Visible {
+    vec4 visible[]; // position, x/y scale
+};
+
+layout (std430, binding = 2) buffer Command {
+    uint vertexCount;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+
+uniform uint u_first;
+uniform uint u_count;
+uniform vec4 u_planes[6]; // normalised, inside is dot(n, p) + d >= 0
+uniform float u_streakZ;
+
+// half the diagonal of a star's quad, anything closer to the frustum
+// than that may still show
+const float RADIUS = 0.7072;
+
+shared uint groupCount;
+shared uint groupBase;
+
+void main()
+{
+    if (gl_LocalInvocationIndex == 0u)
+        groupCount = 0u;
+    barrier();
+
+    uint index = u_first + gl_GlobalInvocationID.x;
+    bool inside = index < u_count;
+    vec3 position = vec3(0.0);
+    if (inside) {
+        position = stars[index].position;
+        for (int plane = 0; plane < 6; ++plane) {
+            inside = inside &&
+                     dot(u_planes[plane].xyz, position) + u_planes[plane].w >=
+                         -RADIUS;
+        }
+    }
+
+    uint slot = 0u;
+    if (inside)
+        slot = atomicAdd(groupCount, 1u);
+    barrier();
+    if (gl_LocalInvocationIndex == 0u)
+        groupBase = atomicAdd(instanceCount, groupCount);
+    barrier();
+
+    if (inside) {
+        float scale = position.z > u_streakZ ? 0.1 : 1.0;
+        visible[groupBase + slot] = vec4(position, scale);
+    }
+}
+)";
+
+StarCuller::StarCuller(size_t capacity)
+    : capacity(capacity),
+      program(makeSimulationProgram(GL_COMPUTE_SHADER, {cullShaderSource})) {
+  glGenBuffers(1, &visible);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, visible);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(StarInstance),
+               nullptr, GL_DYNAMIC_COPY);
+
+  glGenBuffers(1, &command);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, command);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DrawArraysIndirectCommand),
+               nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  glUseProgram(program);
+  glUniform1f(glGetUniformLocation(program, "u_streakZ"), zFar / 2.0f);
+  glUseProgram(0);
+}
+
+StarCuller::~StarCuller() {
+  glDeleteProgram(program);
+  glDeleteBuffers(1, &visible);
+  glDeleteBuffers(1, &command);
+}
+
+void StarCuller::cull(uint32_t starBuffer, size_t stars,
+                      const glm::mat4 &transform, DrawMode mode) {
+  if (stars > capacity)
+    stars = capacity;
+
+  // Gribb/Hartmann: each plane is the last row of the matrix plus or minus
+  // one of the others, in the order left, right, bottom, top, near, far
+  float planes[6][4];
+  for (int plane = 0; plane < 6; ++plane) {
+    int row = plane / 2;
+    float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+    for (int column = 0; column < 4; ++column) {
+      planes[plane][column] =
+          transform[column][3] + sign * transform[column][row];
+    }
+    float length = std::sqrt(planes[plane][0] * planes[plane][0] +
+                             planes[plane][1] * planes[plane][1] +
+                             planes[plane][2] * planes[plane][2]);
+    for (float &value : planes[plane])
+      value /= length;
+  }
+
+  // the vertex count is the only part of the command the CPU knows
+  DrawArraysIndirectCommand reset{(uint32_t)drawModeVertices(mode), 0, 0, 0};
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, command);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(reset), &reset);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, starBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visible);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, command);
+  glUseProgram(program);
+  glUniform1ui(glGetUniformLocation(program, "u_count"), (uint32_t)stars);
+  glUniform4fv(glGetUniformLocation(program, "u_planes"), 6, &planes[0][0]);
+  dispatchStars(program, stars);
+  // the draw reads the command and the visible stars as vertex attributes
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void StarCuller::bindForDraw() {
+  glBindBuffer(GL_ARRAY_BUFFER, visible);
+  setupInstanceAttributes(InstanceFormat::Compact);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StarCuller::draw(DrawMode mode) {
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command);
+  glDrawArraysIndirect(drawModePrimitive(mode), nullptr);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "drawmode.hh"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// GPU frustum culling for stars kept in a storage buffer of GpuStar. A
+// compute pass tests every star against the six planes of the frustum,
+// appends the visible ones as compact StarInstance to a second buffer and
+// counts them with an atomic into a DrawArraysIndirectCommand. The draw then
+// takes its instance count from that command, the CPU never learns how many
+// stars are visible and the vertex stage only sees those that are.
+class StarCuller {
+public:
+  explicit StarCuller(size_t capacity);
+  StarCuller(const StarCuller &) = delete;
+  StarCuller &operator=(const StarCuller &) = delete;
+  ~StarCuller();
+
+  // Culls stars [0, stars) of starBuffer against the frustum of transform
+  // (projection * view * model) for a draw in mode. Binds its own program.
+  void cull(uint32_t starBuffer, size_t stars, const glm::mat4 &transform,
+            DrawMode mode);
+  // Points attribute 1 of the bound VAO at the visible stars, in the
+  // InstanceFormat::Compact layout.
+  void bindForDraw();
+  // Draws the visible stars with the bound program and VAO.
+  void draw(DrawMode mode);
+
+private:
+  size_t capacity;
+  uint32_t visible{0};
+  uint32_t command{0};
+  uint32_t program{0};
+};
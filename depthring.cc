@@ -0,0 +1,55 @@
+#include "depthring.hh"
+#include "config.hh"
+#include "rng.hh"
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+DepthRing::DepthRing(StarField unsorted, uint32_t seed, float zMin,
+                     float limit)
+    : stars(unsorted.size()), keyX(streamKey(seed, STREAM_X)),
+      keyY(streamKey(seed, STREAM_Y)), limit(limit), depth(limit - zMin) {
+  std::vector<uint32_t> order(unsorted.size());
+  std::iota(order.begin(), order.end(), 0);
+  const float *zs = unsorted.z();
+  std::sort(order.begin(), order.end(),
+            [zs](uint32_t a, uint32_t b) { return zs[a] > zs[b]; });
+
+  for (size_t slot = 0; slot < order.size(); ++slot) {
+    stars.x()[slot] = unsorted.x()[order[slot]];
+    stars.y()[slot] = unsorted.y()[order[slot]];
+    stars.z()[slot] = unsorted.z()[order[slot]];
+  }
+}
+
+void DepthRing::recycle(size_t slot) {
+  uint32_t generation = ++stars.generation()[slot];
+  stars.x()[slot] = counterUniform(keyX, (uint32_t)slot, generation, 0.0f,
+                                   (float)SCREEN_WIDTH);
+  stars.y()[slot] = counterUniform(keyY, (uint32_t)slot, generation, 0.0f,
+                                   (float)SCREEN_HEIGHT);
+  stars.z()[slot] -= depth;
+}
+
+size_t DepthRing::advance(float step) {
+  if (stars.size() == 0)
+    return 0;
+
+  offset += step;
+  size_t recycled{0};
+  while (recycled < stars.size() && z(head) > limit) {
+    recycle(head);
+    head = head + 1 == stars.size() ? 0 : head + 1;
+    recycled++;
+  }
+
+  // keep offset small so z stays precise, once per trip through the field
+  if (offset >= depth) {
+    float *zs = stars.z();
+    for (size_t slot = 0; slot < stars.size(); ++slot) {
+      zs[slot] += depth;
+    }
+    offset -= depth;
+  }
+  return recycled;
+}
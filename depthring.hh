@@ -0,0 +1,42 @@
+#pragma once
+#include "starfield.hh"
+#include <cstddef>
+#include <cstdint>
+
+// Star store kept sorted by z as a ring. All stars move at the same speed, so
+// instead of touching every star the ring keeps one shared offset and only
+// stores each star's z relative to it. Going forward from head, z decreases.
+// Stars that pass the far limit are always the ones at the head: they wrap
+// back by the depth of the field and become the new tail, which keeps the
+// ring sorted. Advancing is an offset bump plus work per recycled star, and
+// walking the ring backwards from the head gives back to front order.
+class DepthRing {
+public:
+  // zMin and limit bound the field, stars must start inside it.
+  DepthRing(StarField stars, uint32_t seed, float zMin, float limit);
+
+  size_t size() const { return stars.size(); }
+
+  // Moves every star by step, returns how many were recycled.
+  size_t advance(float step);
+
+  // The k-th star in back to front order, k = 0 is the farthest.
+  size_t slot(size_t k) const {
+    size_t farthest = head == 0 ? stars.size() - 1 : head - 1;
+    return k <= farthest ? farthest - k : farthest + stars.size() - k;
+  }
+  float x(size_t slot) const { return stars.x()[slot]; }
+  float y(size_t slot) const { return stars.y()[slot]; }
+  float z(size_t slot) const { return stars.z()[slot] + offset; }
+
+private:
+  void recycle(size_t slot);
+
+  StarField stars; // z holds z - offset
+  uint32_t keyX;
+  uint32_t keyY;
+  float limit;
+  float depth;
+  float offset{0.0f};
+  size_t head{0};
+};
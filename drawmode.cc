@@ -0,0 +1,175 @@
+// clang-format off
+#include "khrplatform.h"
+#include "glad.h"
+// clang-format on
+#include "drawmode.hh"
+#include <cstring>
+#include <initializer_list>
+
+const char *drawModeName(DrawMode mode) {
+  switch (mode) {
+  case DrawMode::Points:
+    return "points";
+  case DrawMode::Strip:
+    return "strip";
+  case DrawMode::Quads:
+    break;
+  }
+  return "quads";
+}
+
+bool parseDrawMode(const char *name, DrawMode &mode) {
+  for (DrawMode candidate :
+       {DrawMode::Quads, DrawMode::Points, DrawMode::Strip}) {
+    if (std::strcmp(name, drawModeName(candidate)) == 0) {
+      mode = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+int drawModeVertices(DrawMode mode) {
+  switch (mode) {
+  case DrawMode::Points:
+    return 1;
+  case DrawMode::Strip:
+    return 4;
+  case DrawMode::Quads:
+    break;
+  }
+  return 6;
+}
+
+uint32_t drawModePrimitive(DrawMode mode) {
+  switch (mode) {
+  case DrawMode::Points:
+    return GL_POINTS;
+  case DrawMode::Strip:
+    return GL_TRIANGLE_STRIP;
+  case DrawMode::Quads:
+    break;
+  }
+  return GL_TRIANGLES;
+}
+
+static const char *const quadsVertexSource = R"(
+layout (location = 0) in vec3 aPos;
+
+out vec4 mycolour;
+
+uniform mat4 model;
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
+uniform vec2 u_resolution;
+
+void placeStar(vec3 offset, float scale)
+{
+    vec3 local = vec3(aPos.xy * scale, aPos.z);
+    gl_Position = projection * view * model * vec4(local + offset, 1.0);
+
+    vec3 ndc = gl_Position.xyz / gl_Position.w;
+    mycolour = vec4(1.0,1.0,1.0,1.0)*ndc.z;
+}
+)";
+
+// corners 0..3 as a strip: (-.5,-.5) (.5,-.5) (-.5,.5) (.5,.5)
+static const char *const stripVertexSource = R"(
+out vec4 mycolour;
+
+uniform mat4 model;
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
+uniform vec2 u_resolution;
+
+void placeStar(vec3 offset, float scale)
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) - 0.5;
+    vec3 local = vec3(corner * scale, 0.0);
+    gl_Position = projection * view * model * vec4(local + offset, 1.0);
+
+    vec3 ndc = gl_Position.xyz / gl_Position.w;
+    mycolour = vec4(1.0,1.0,1.0,1.0)*ndc.z;
+}
+)";
+
+// a point as wide on screen as the quad would be, never under a pixel
+static const char *const pointsVertexSource = R"(
+out vec4 mycolour;
+
+uniform mat4 model;
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
+uniform vec2 u_resolution;
+uniform float u_pointScale; // pixels per world unit at distance 1
+
+void placeStar(vec3 offset, float scale)
+{
+    gl_Position = projection * view * model * vec4(offset, 1.0);
+    gl_PointSize = max(scale * u_pointScale / gl_Position.w, 1.0);
+
+    vec3 ndc = gl_Position.xyz / gl_Position.w;
+    mycolour = vec4(1.0,1.0,1.0,1.0)*ndc.z;
+}
+)";
+
+const char *drawModeVertexSource(DrawMode mode) {
+  switch (mode) {
+  case DrawMode::Points:
+    return pointsVertexSource;
+  case DrawMode::Strip:
+    return stripVertexSource;
+  case DrawMode::Quads:
+    break;
+  }
+  return quadsVertexSource;
+}
+
+static const char *const fragmentShaderSource = R"(
+#version 330 core
+out vec4 FragColor;
+in vec4 mycolour;
+void main()
+{
+    FragColor = vec4(mycolour);
+} )";
+
+static const char *const pointsFragmentShaderSource = R"(
+#version 330 core
+out vec4 FragColor;
+in vec4 mycolour;
+void main()
+{
+    if (length(gl_PointCoord - vec2(0.5)) > 0.5)
+        discard;
+    FragColor = vec4(mycolour);
+} )";
+
+const char *drawModeFragmentShaderSource(DrawMode mode) {
+  return mode == DrawMode::Points ? pointsFragmentShaderSource
+                                  : fragmentShaderSource;
+}
+
+void setDrawModeUniforms(uint32_t program, float focal, int height) {
+  glUniform1f(glGetUniformLocation(program, "u_pointScale"),
+              focal * height / 2.0f);
+}
+
+void drawStars(DrawMode mode, size_t stars, uint32_t baseInstance) {
+  GLenum primitive = drawModePrimitive(mode);
+  // only the persistent upload (GL 4.4) ever has a base instance, GL 3.3
+  // has no glDrawArraysInstancedBaseInstance
+  if (baseInstance == 0) {
+    glDrawArraysInstanced(primitive, 0, drawModeVertices(mode),
+                          (GLsizei)stars);
+  } else {
+    glDrawArraysInstancedBaseInstance(primitive, 0, drawModeVertices(mode),
+                                      (GLsizei)stars, baseInstance);
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// How a star's instance becomes pixels.
+enum class DrawMode {
+  Quads,  // 6 vertices per star from the quad vertex buffer, two triangles
+  Points, // 1 vertex per star, a point sprite rounded in the fragment shader
+  Strip   // 4 vertices per star made from gl_VertexID, no vertex buffer
+};
+
+const char *drawModeName(DrawMode mode);
+bool parseDrawMode(const char *name, DrawMode &mode);
+// Vertex shader invocations per star.
+int drawModeVertices(DrawMode mode);
+// GL primitive the vertices make up.
+uint32_t drawModePrimitive(DrawMode mode);
+
+// The star vertex shaders only work out where a star is and how big, then
+// call
+//   void placeStar(vec3 offset, float scale);
+// which comes from appending drawModeVertexSource(mode) to their source. It
+// declares the model uniform, the Camera block (see CameraBlock) and the
+// mycolour output.
+const char *drawModeVertexSource(DrawMode mode);
+const char *drawModeFragmentShaderSource(DrawMode mode);
+// Point size uniform, focal is projection[1][1] and height the viewport's.
+void setDrawModeUniforms(uint32_t program, float focal, int height);
+
+// Draws stars instances starting at baseInstance with the bound program and
+// VAO. Points also need GL_PROGRAM_POINT_SIZE enabled.
+void drawStars(DrawMode mode, size_t stars, uint32_t baseInstance);
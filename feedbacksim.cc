@@ -0,0 +1,137 @@
+// clang-format off
+#include "khrplatform.h"
+#include "glad.h"
+// clang-format on
+#include "feedbacksim.hh"
+#include <cstddef>
+
+// GLSL 3.30 has no precise, the multiply and add may get fused here
+static const char *const feedbackShaderHeader = R"(#version 330 core
+#define PRECISE
+)";
+
+// same advance and respawn as advanceScalar, one vertex per star
+static const char *const feedbackShaderSource = R"(
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in uint aGeneration;
+
+out vec3 position;
+flat out uint generation;
+
+uniform int u_ticks;
+uniform float u_step;
+uniform float u_limit;
+uniform uvec3 u_keys;
+uniform vec2 u_respawn; // zMin, zRange
+uniform vec2 u_field;   // width, height
+
+void main()
+{
+    uint index = uint(gl_VertexID);
+    position = aPosition;
+    generation = aGeneration;
+    for (int tick = 0; tick < u_ticks; ++tick) {
+        position.z += u_step;
+        if (position.z > u_limit) {
+            generation++;
+            position = vec3(
+                counterUniform(u_keys.x, index, generation, 0.0, u_field.x),
+                counterUniform(u_keys.y, index, generation, 0.0, u_field.y),
+                counterUniform(u_keys.z, index, generation, u_respawn.x,
+                               u_respawn.y));
+        }
+    }
+}
+)";
+
+static const char *const feedbackVertexShaderSource = R"(
+#version 330 core
+layout (location = 1) in vec3 aStar;
+
+uniform float u_streakZ;
+
+void placeStar(vec3 offset, float scale);
+
+void main()
+{
+    placeStar(aStar, aStar.z > u_streakZ ? 0.1 : 1.0);
+}
+)";
+
+FeedbackSimulation::FeedbackSimulation(uint32_t amount, uint32_t seed)
+    : GpuSimulation(amount),
+      program(makeSimulationProgram(
+          GL_VERTEX_SHADER,
+          {feedbackShaderHeader, gpuCounterRandomSource,
+           feedbackShaderSource},
+          {"position", "generation"})) {
+  std::vector<GpuStar> stars = initialGpuStars(amount, seed);
+
+  glGenBuffers(2, buffers);
+  glGenVertexArrays(2, arrays);
+  for (int index = 0; index < 2; ++index) {
+    glBindVertexArray(arrays[index]);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[index]);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(GpuStar),
+                 index == 0 ? stars.data() : nullptr, GL_DYNAMIC_COPY);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GpuStar),
+                          (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(GpuStar),
+                           (void *)offsetof(GpuStar, generation));
+    glEnableVertexAttribArray(1);
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glUseProgram(program);
+  setRespawnUniforms(program, seed);
+  glUseProgram(0);
+}
+
+FeedbackSimulation::~FeedbackSimulation() {
+  glDeleteProgram(program);
+  glDeleteVertexArrays(2, arrays);
+  glDeleteBuffers(2, buffers);
+}
+
+void FeedbackSimulation::advance(int ticks, float step) {
+  if (ticks < 1)
+    return;
+
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "u_ticks"), ticks);
+  glUniform1f(glGetUniformLocation(program, "u_step"), step);
+
+  glEnable(GL_RASTERIZER_DISCARD);
+  glBindVertexArray(arrays[current]);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1 - current]);
+  glBeginTransformFeedback(GL_POINTS);
+  glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+  glEndTransformFeedback();
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  glBindVertexArray(0);
+  glDisable(GL_RASTERIZER_DISCARD);
+  current = 1 - current;
+}
+
+void FeedbackSimulation::bindForDraw() {
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[current]);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GpuStar), (void *)0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribDivisor(1, 1);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+std::vector<GpuStar> FeedbackSimulation::readBack() const {
+  std::vector<GpuStar> stars(count);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[current]);
+  glGetBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(GpuStar),
+                     stars.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return stars;
+}
+
+const char *FeedbackSimulation::vertexShaderSource() const {
+  return feedbackVertexShaderSource;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "gpusim.hh"
+#include <cstdint>
+#include <vector>
+
+// GpuSimulation for GL 3.3 class drivers without compute shaders. The stars
+// live in two vertex buffers: a vertex shader reads one, advances and
+// respawns each star and writes it to the other with transform feedback
+// while rasterisation is off, then the two swap. The draw takes the
+// positions from the freshest buffer as a per instance attribute.
+class FeedbackSimulation : public GpuSimulation {
+public:
+  FeedbackSimulation(uint32_t amount, uint32_t seed);
+  ~FeedbackSimulation() override;
+
+  void advance(int ticks, float step) override;
+  // Points attribute 1 of the bound VAO at the current buffer.
+  void bindForDraw() override;
+  std::vector<GpuStar> readBack() const override;
+  const char *vertexShaderSource() const override;
+
+private:
+  uint32_t buffers[2]{};
+  // reads buffers[i] as the feedback pass input
+  uint32_t arrays[2]{};
+  int current{0};
+  uint32_t program{0};
+};
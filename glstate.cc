@@ -0,0 +1,204 @@
+// clang-format off
+#include "khrplatform.h"
+#include "glad.h"
+// clang-format on
+#include "glstate.hh"
+#include <atomic>
+#include <glm/gtc/type_ptr.hpp>
+#include <type_traits>
+#include <vector>
+
+void GlState::useProgram(uint32_t program) {
+  if (program == this->program)
+    return;
+  glUseProgram(program);
+  this->program = program;
+}
+
+void GlState::bindVertexArray(uint32_t vertexArray) {
+  if (vertexArray == this->vertexArray)
+    return;
+  glBindVertexArray(vertexArray);
+  this->vertexArray = vertexArray;
+}
+
+void GlState::invalidate() {
+  program = UNKNOWN;
+  vertexArray = UNKNOWN;
+}
+
+UniformCache::UniformCache(uint32_t program) {
+  GLint count{0};
+  GLint longest{0};
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &longest);
+  std::vector<char> name(longest + 1);
+  for (GLint index = 0; index < count; ++index) {
+    GLsizei length{0};
+    GLint size{0};
+    GLenum type{0};
+    glGetActiveUniform(program, index, (GLsizei)name.size(), &length, &size,
+                       &type, name.data());
+    std::string uniform(name.data(), length);
+    // arrays are listed as name[0], looked up as name
+    size_t bracket = uniform.find('[');
+    if (bracket != std::string::npos)
+      uniform.resize(bracket);
+    // members of uniform blocks have no location
+    int location = glGetUniformLocation(program, uniform.c_str());
+    if (location >= 0)
+      locations[uniform] = location;
+  }
+}
+
+int UniformCache::operator[](const char *name) const {
+  auto found = locations.find(name);
+  return found == locations.end() ? -1 : found->second;
+}
+
+CameraBlock::CameraBlock() {
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BINDING, buffer);
+}
+
+CameraBlock::~CameraBlock() { glDeleteBuffers(1, &buffer); }
+
+void CameraBlock::attach(uint32_t program) const {
+  GLuint block = glGetUniformBlockIndex(program, "Camera");
+  if (block != GL_INVALID_INDEX)
+    glUniformBlockBinding(program, block, CAMERA_BINDING);
+}
+
+void CameraBlock::update(const glm::mat4 &view, const glm::mat4 &projection) {
+  if (uploaded && view == this->view && projection == this->projection)
+    return;
+  // std140 lays out two mat4 back to back, column major like glm
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
+                  glm::value_ptr(view));
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4),
+                  glm::value_ptr(projection));
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  this->view = view;
+  this->projection = projection;
+  uploaded = true;
+}
+
+static std::atomic<uint64_t> calls{0};
+
+// Takes the place of the glad pointer Slot: counts, then calls the driver.
+template <auto &Slot, typename Proc> struct CountedCall;
+template <auto &Slot, typename Result, typename... Args>
+struct CountedCall<Slot, Result(APIENTRY *)(Args...)> {
+  static inline Result(APIENTRY *original)(Args...) = nullptr;
+
+  static Result APIENTRY call(Args... args) {
+    calls.fetch_add(1, std::memory_order_relaxed);
+    return original(args...);
+  }
+  static void install() {
+    if (Slot == nullptr || original != nullptr)
+      return;
+    original = Slot;
+    Slot = call;
+  }
+};
+
+#define COUNT_GL(name)                                                         \
+  CountedCall<glad_##name,                                                     \
+              std::remove_reference_t<decltype(glad_##name)>>::install()
+
+void countGlCalls() {
+  COUNT_GL(glAttachShader);
+  COUNT_GL(glBeginQuery);
+  COUNT_GL(glBeginTransformFeedback);
+  COUNT_GL(glBindBuffer);
+  COUNT_GL(glBindBufferBase);
+  COUNT_GL(glBindFramebuffer);
+  COUNT_GL(glBindRenderbuffer);
+  COUNT_GL(glBindVertexArray);
+  COUNT_GL(glBufferData);
+  COUNT_GL(glBufferStorage);
+  COUNT_GL(glBufferSubData);
+  COUNT_GL(glCheckFramebufferStatus);
+  COUNT_GL(glClear);
+  COUNT_GL(glClearColor);
+  COUNT_GL(glClientWaitSync);
+  COUNT_GL(glCompileShader);
+  COUNT_GL(glCreateProgram);
+  COUNT_GL(glCreateShader);
+  COUNT_GL(glDebugMessageCallback);
+  COUNT_GL(glDebugMessageControl);
+  COUNT_GL(glDeleteBuffers);
+  COUNT_GL(glDeleteFramebuffers);
+  COUNT_GL(glDeleteProgram);
+  COUNT_GL(glDeleteQueries);
+  COUNT_GL(glDeleteRenderbuffers);
+  COUNT_GL(glDeleteShader);
+  COUNT_GL(glDeleteSync);
+  COUNT_GL(glDeleteVertexArrays);
+  COUNT_GL(glDepthFunc);
+  COUNT_GL(glDisable);
+  COUNT_GL(glDispatchCompute);
+  COUNT_GL(glDrawArrays);
+  COUNT_GL(glDrawArraysIndirect);
+  COUNT_GL(glDrawArraysInstanced);
+  COUNT_GL(glDrawArraysInstancedBaseInstance);
+  COUNT_GL(glEnable);
+  COUNT_GL(glEnableVertexAttribArray);
+  COUNT_GL(glEndQuery);
+  COUNT_GL(glEndTransformFeedback);
+  COUNT_GL(glFenceSync);
+  COUNT_GL(glFinish);
+  COUNT_GL(glFlush);
+  COUNT_GL(glFramebufferRenderbuffer);
+  COUNT_GL(glGenBuffers);
+  COUNT_GL(glGenFramebuffers);
+  COUNT_GL(glGenQueries);
+  COUNT_GL(glGenRenderbuffers);
+  COUNT_GL(glGenVertexArrays);
+  COUNT_GL(glGetActiveUniform);
+  COUNT_GL(glGetBufferParameteriv);
+  COUNT_GL(glGetBufferSubData);
+  COUNT_GL(glGetIntegerv);
+  COUNT_GL(glGetProgramInfoLog);
+  COUNT_GL(glGetProgramiv);
+  COUNT_GL(glGetQueryObjectiv);
+  COUNT_GL(glGetQueryObjectui64v);
+  COUNT_GL(glGetShaderInfoLog);
+  COUNT_GL(glGetShaderiv);
+  COUNT_GL(glGetString);
+  COUNT_GL(glGetUniformBlockIndex);
+  COUNT_GL(glGetUniformLocation);
+  COUNT_GL(glLinkProgram);
+  COUNT_GL(glMapBufferRange);
+  COUNT_GL(glMemoryBarrier);
+  COUNT_GL(glPixelStorei);
+  COUNT_GL(glReadPixels);
+  COUNT_GL(glRenderbufferStorage);
+  COUNT_GL(glShaderSource);
+  COUNT_GL(glTransformFeedbackVaryings);
+  COUNT_GL(glUniform1f);
+  COUNT_GL(glUniform1i);
+  COUNT_GL(glUniform1ui);
+  COUNT_GL(glUniform2f);
+  COUNT_GL(glUniform3f);
+  COUNT_GL(glUniform3ui);
+  COUNT_GL(glUniform4f);
+  COUNT_GL(glUniform4fv);
+  COUNT_GL(glUniformBlockBinding);
+  COUNT_GL(glUniformMatrix4fv);
+  COUNT_GL(glUnmapBuffer);
+  COUNT_GL(glUseProgram);
+  COUNT_GL(glVertexAttribDivisor);
+  COUNT_GL(glVertexAttribIPointer);
+  COUNT_GL(glVertexAttribPointer);
+  COUNT_GL(glViewport);
+  COUNT_GL(glWaitSync);
+}
+
+uint64_t glCalls() { return calls.load(std::memory_order_relaxed); }
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+
+// Program and vertex array bindings of the render loop. Switching to what is
+// already bound is skipped. Code that binds its own (the GPU simulation,
+// the culler) leaves this out of date, call invalidate() after it.
+class GlState {
+public:
+  void useProgram(uint32_t program);
+  void bindVertexArray(uint32_t vertexArray);
+  void invalidate();
+
+private:
+  static constexpr uint32_t UNKNOWN = ~0u;
+
+  uint32_t program{UNKNOWN};
+  uint32_t vertexArray{UNKNOWN};
+};
+
+// Every active uniform's location, read once right after linking so that
+// looking one up later needs no glGetUniformLocation.
+class UniformCache {
+public:
+  explicit UniformCache(uint32_t program);
+  // -1 for names the program does not use, like glGetUniformLocation.
+  int operator[](const char *name) const;
+
+private:
+  std::unordered_map<std::string, int> locations;
+};
+
+// The Camera uniform block of the star vertex shaders, view and projection
+// in a uniform buffer on binding CAMERA_BINDING. Only uploaded when either
+// changes, which for the fixed camera means once.
+class CameraBlock {
+public:
+  static constexpr uint32_t CAMERA_BINDING = 0;
+
+  CameraBlock();
+  CameraBlock(const CameraBlock &) = delete;
+  CameraBlock &operator=(const CameraBlock &) = delete;
+  ~CameraBlock();
+
+  // Points program's Camera block at the buffer, once after linking.
+  void attach(uint32_t program) const;
+  void update(const glm::mat4 &view, const glm::mat4 &projection);
+
+private:
+  uint32_t buffer{0};
+  bool uploaded{false};
+  glm::mat4 view{0.0f};
+  glm::mat4 projection{0.0f};
+};
+
+// Makes every GL function this program calls count itself, for both
+// contexts. Call after loading GL, only calls made from then on count, so
+// not the headless framebuffer setup. glCalls() is the total so far.
+void countGlCalls();
+uint64_t glCalls();
@@ -0,0 +1,341 @@
+// clang-format off
+#include "khrplatform.h"
+#include "glad.h"
+// clang-format on
+#include "gpusim.hh"
+#include "advance.hh"
+#include "config.hh"
+#include "feedbacksim.hh"
+#include "rng.hh"
+#include "simulation.hh"
+#include "starfield.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// work groups per dispatch, the smallest GL_MAX_COMPUTE_WORK_GROUP_COUNT
+// any implementation may have
+constexpr uint32_t MAX_GROUPS = 65535;
+// largest difference in world units verifyGpuSimulation lets through
+constexpr float GPU_TOLERANCE = 1e-3f;
+
+const char *simBackendName(SimBackend backend) {
+  switch (backend) {
+  case SimBackend::Compute:
+    return "compute";
+  case SimBackend::Feedback:
+    return "feedback";
+  case SimBackend::Cpu:
+    break;
+  }
+  return "cpu";
+}
+
+bool parseSimBackend(const char *name, SimBackend &backend) {
+  for (SimBackend candidate :
+       {SimBackend::Cpu, SimBackend::Compute, SimBackend::Feedback}) {
+    if (std::strcmp(name, simBackendName(candidate)) == 0) {
+      backend = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+SimBackend supportedSimBackend(SimBackend wanted) {
+  if (wanted != SimBackend::Compute)
+    return wanted;
+  int vertexBlocks{0};
+  if (GLAD_GL_VERSION_4_3 || (GLAD_GL_ARB_compute_shader &&
+                              GLAD_GL_ARB_shader_storage_buffer_object)) {
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBlocks);
+  }
+  if (vertexBlocks < 1) {
+    std::cout << "no compute shaders or vertex storage buffers, simulating "
+                 "with transform feedback"
+              << std::endl;
+    return SimBackend::Feedback;
+  }
+  return wanted;
+}
+
+// mix32/counterRandom/counterUniform must match rng.hh bit for bit
+const char *const gpuCounterRandomSource = R"(
+uint mix32(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float counterUniform(uint key, uint index, uint generation, float lo, float range)
+{
+    uint bits = mix32(mix32(index + key) ^ (generation * 0x9e3779b9u));
+    PRECISE float value = lo + float(bits >> 8) * (1.0 / 16777216.0) * range;
+    return value;
+}
+)";
+
+static const char *const computeShaderHeader = R"(#version 430 core
+#define PRECISE precise
+)";
+
+// same advance and respawn as advanceScalar
+static const char *const computeShaderSource = R"(
+layout (local_size_x = 256) in;
+
+struct Star {
+    vec3 position;
+    uint generation;
+};
+
+layout (std430, binding = 0) buffer Stars {
+    Star stars[];
+};
+
+uniform uint u_first;
+uniform uint u_count;
+uniform int u_ticks;
+uniform float u_step;
+uniform float u_limit;
+uniform uvec3 u_keys;
+uniform vec2 u_respawn; // zMin, zRange
+uniform vec2 u_field;   // width, height
+
+void main()
+{
+    uint index = u_first + gl_GlobalInvocationID.x;
+    if (index >= u_count)
+        return;
+
+    vec3 position = stars[index].position;
+    uint generation = stars[index].generation;
+    for (int tick = 0; tick < u_ticks; ++tick) {
+        position.z += u_step;
+        if (position.z > u_limit) {
+            generation++;
+            position = vec3(
+                counterUniform(u_keys.x, index, generation, 0.0, u_field.x),
+                counterUniform(u_keys.y, index, generation, 0.0, u_field.y),
+                counterUniform(u_keys.z, index, generation, u_respawn.x,
+                               u_respawn.y));
+        }
+    }
+    stars[index].position = position;
+    stars[index].generation = generation;
+}
+)";
+
+static const char *const computeVertexShaderSource = R"(
+#version 430 core
+struct Star {
+    vec3 position;
+    uint generation;
+};
+
+layout (std430, binding = 0) readonly buffer Stars {
+    Star stars[];
+};
+
+uniform float u_streakZ;
+
+void placeStar(vec3 offset, float scale);
+
+void main()
+{
+    vec3 offset = stars[gl_InstanceID].position;
+    placeStar(offset, offset.z > u_streakZ ? 0.1 : 1.0);
+}
+)";
+
+void GpuSimulation::setDrawUniforms(uint32_t program) const {
+  glUniform1f(glGetUniformLocation(program, "u_streakZ"), zFar / 2.0f);
+}
+
+std::vector<GpuStar> initialGpuStars(uint32_t amount, uint32_t seed) {
+  StarField field = generateStarOffsets(amount, seed);
+  std::vector<GpuStar> stars(amount);
+  for (size_t index = 0; index < amount; ++index) {
+    stars[index] = GpuStar{field.x()[index], field.y()[index],
+                           field.z()[index], field.generation()[index]};
+  }
+  return stars;
+}
+
+uint32_t makeSimulationProgram(uint32_t type,
+                               std::initializer_list<const char *> sources,
+                               std::initializer_list<const char *> varyings) {
+  int success{0};
+  char infoLog[1024];
+
+  uint32_t shader = glCreateShader(type);
+  glShaderSource(shader, (GLsizei)sources.size(), sources.begin(), nullptr);
+  glCompileShader(shader);
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (!success) {
+    glGetShaderInfoLog(shader, sizeof(infoLog), nullptr, infoLog);
+    std::cerr << "Error compiling the star simulation shader\n"
+              << infoLog << std::endl;
+    exit(1);
+  }
+
+  uint32_t program = glCreateProgram();
+  glAttachShader(program, shader);
+  if (varyings.size() > 0) {
+    glTransformFeedbackVaryings(program, (GLsizei)varyings.size(),
+                                varyings.begin(), GL_INTERLEAVED_ATTRIBS);
+  }
+  glLinkProgram(program);
+  glDeleteShader(shader);
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    glGetProgramInfoLog(program, sizeof(infoLog), nullptr, infoLog);
+    std::cerr << "Error linking the star simulation shader\n"
+              << infoLog << std::endl;
+    exit(1);
+  }
+  return program;
+}
+
+void setRespawnUniforms(uint32_t program, uint32_t seed) {
+  Respawn respawn = starRespawn(seed);
+  glUniform1f(glGetUniformLocation(program, "u_limit"), respawnLimit());
+  glUniform3ui(glGetUniformLocation(program, "u_keys"),
+               streamKey(seed, STREAM_X), streamKey(seed, STREAM_Y),
+               respawn.key);
+  glUniform2f(glGetUniformLocation(program, "u_respawn"), respawn.zMin,
+              respawn.zRange);
+  glUniform2f(glGetUniformLocation(program, "u_field"), (float)SCREEN_WIDTH,
+              (float)SCREEN_HEIGHT);
+}
+
+void dispatchStars(uint32_t program, size_t stars) {
+  int first = glGetUniformLocation(program, "u_first");
+  for (size_t begin = 0; begin < stars;
+       begin += STAR_GROUP_SIZE * MAX_GROUPS) {
+    size_t groups = std::min<size_t>(
+        (stars - begin + STAR_GROUP_SIZE - 1) / STAR_GROUP_SIZE, MAX_GROUPS);
+    glUniform1ui(first, (uint32_t)begin);
+    glDispatchCompute((uint32_t)groups, 1, 1);
+  }
+}
+
+std::unique_ptr<GpuSimulation>
+makeGpuSimulation(SimBackend backend, uint32_t amount, uint32_t seed) {
+  if (backend == SimBackend::Feedback)
+    return std::make_unique<FeedbackSimulation>(amount, seed);
+  return std::make_unique<ComputeSimulation>(amount, seed);
+}
+
+ComputeSimulation::ComputeSimulation(uint32_t amount, uint32_t seed)
+    : GpuSimulation(amount),
+      program(makeSimulationProgram(
+          GL_COMPUTE_SHADER, {computeShaderHeader, gpuCounterRandomSource,
+                              computeShaderSource})) {
+  std::vector<GpuStar> stars = initialGpuStars(amount, seed);
+
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GpuStar),
+               stars.data(), GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  glUseProgram(program);
+  glUniform1ui(glGetUniformLocation(program, "u_count"), (uint32_t)count);
+  setRespawnUniforms(program, seed);
+  glUseProgram(0);
+}
+
+ComputeSimulation::~ComputeSimulation() {
+  glDeleteProgram(program);
+  glDeleteBuffers(1, &buffer);
+}
+
+void ComputeSimulation::advance(int ticks, float step) {
+  if (ticks < 1)
+    return;
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffer);
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "u_ticks"), ticks);
+  glUniform1f(glGetUniformLocation(program, "u_step"), step);
+  dispatchStars(program, count);
+  // the draw reads what the dispatches wrote
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void ComputeSimulation::bindForDraw() {
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffer);
+}
+
+const char *ComputeSimulation::vertexShaderSource() const {
+  return computeVertexShaderSource;
+}
+
+std::vector<GpuStar> ComputeSimulation::readBack() const {
+  std::vector<GpuStar> stars(count);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GpuStar),
+                     stars.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  return stars;
+}
+
+size_t verifyGpuSimulation(SimBackend backend, uint32_t amount,
+                           uint32_t seed, int frames, float step) {
+  StarField field = generateStarOffsets(amount, seed);
+  std::vector<uint32_t> respawned(amount);
+  AdvanceKernel advance = selectAdvanceKernel(SimdIsa::Scalar);
+  Respawn respawn = starRespawn(seed);
+  std::unique_ptr<GpuSimulation> gpu =
+      makeGpuSimulation(backend, amount, seed);
+
+  size_t respawns{0};
+  size_t different{0};
+  float largest{0.0f};
+  int frame{0};
+  for (; frame < frames && different == 0; ++frame) {
+    int ticks = 1 + frame % 3;
+    for (int tick = 0; tick < ticks; ++tick) {
+      size_t count = advance(field.z(), field.generation(), 0, amount, step,
+                             respawnLimit(), respawn, respawned.data());
+      for (size_t k = 0; k < count; ++k) {
+        uint32_t index = respawned[k];
+        respawnPosition(seed, index, field.generation()[index],
+                        field.x()[index], field.y()[index]);
+      }
+      respawns += count;
+    }
+    gpu->advance(ticks, step);
+
+    std::vector<GpuStar> stars = gpu->readBack();
+    for (size_t index = 0; index < amount; ++index) {
+      float error = std::max({std::fabs(stars[index].x - field.x()[index]),
+                              std::fabs(stars[index].y - field.y()[index]),
+                              std::fabs(stars[index].z - field.z()[index])});
+      largest = std::max(largest, error);
+      if (error > GPU_TOLERANCE ||
+          stars[index].generation != field.generation()[index]) {
+        if (different == 0) {
+          std::cerr << "frame " << frame << " star " << index << ": cpu ("
+                    << field.z()[index] << ", generation "
+                    << field.generation()[index] << ") gpu ("
+                    << stars[index].z << ", generation "
+                    << stars[index].generation << ")" << std::endl;
+        }
+        different++;
+      }
+    }
+  }
+
+  std::cout << simBackendName(backend) << " check: " << amount << " stars, "
+            << frame << " frames, " << respawns
+            << " respawns, largest difference " << largest << ", "
+            << different << " stars differ" << std::endl;
+  return different;
+}
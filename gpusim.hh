@@ -0,0 +1,113 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+enum class SimBackend {
+  Cpu,     // StarSimulation on the job scheduler, instances uploaded
+  Compute, // ComputeSimulation, star state never leaves the GPU
+  Feedback // FeedbackSimulation, the same on GL 3.3 without compute shaders
+};
+
+const char *simBackendName(SimBackend backend);
+bool parseSimBackend(const char *name, SimBackend &backend);
+// Compute needs GL 4.3 (or the compute shader and storage buffer extensions)
+// and storage buffers in the vertex shader, falls back to Feedback, which
+// any 3.3 context can do.
+SimBackend supportedSimBackend(SimBackend wanted);
+
+// One star in GPU memory, the std430 layout of the compute shaders' Star
+// struct and the interleaved transform feedback output alike.
+struct GpuStar {
+  float x, y, z;
+  uint32_t generation;
+};
+static_assert(sizeof(GpuStar) == 16, "GpuStar must match the std430 layout");
+
+// Stars placed like generateStarOffsets(amount, seed) does.
+std::vector<GpuStar> initialGpuStars(uint32_t amount, uint32_t seed);
+
+// Star simulation that lives on the GPU. Every star's position and
+// generation sit in GPU buffers and are advanced and respawned there with
+// the same counter hash and respawn rule as the CPU kernels, then drawn
+// straight from those buffers. Nothing goes over the bus per frame.
+class GpuSimulation {
+public:
+  explicit GpuSimulation(size_t amount) : count(amount) {}
+  GpuSimulation(const GpuSimulation &) = delete;
+  GpuSimulation &operator=(const GpuSimulation &) = delete;
+  virtual ~GpuSimulation() = default;
+
+  size_t size() const { return count; }
+  // Runs ticks steps of step on the GPU.
+  virtual void advance(int ticks, float step) = 0;
+  // Makes the current stars visible to vertexShaderSource(), call with the
+  // draw VAO bound.
+  virtual void bindForDraw() = 0;
+  // Copies the stars back, waits for the GPU. For checking only.
+  virtual std::vector<GpuStar> readBack() const = 0;
+  // Vertex shader that draws these stars, append drawModeVertexSource to it
+  // and set its uniforms with setDrawUniforms.
+  virtual const char *vertexShaderSource() const = 0;
+  void setDrawUniforms(uint32_t program) const;
+  // Shader storage buffer of GpuStar the stars live in, 0 when they are not
+  // kept in one.
+  virtual uint32_t storageBuffer() const { return 0; }
+
+protected:
+  size_t count;
+};
+
+// Compute shader over a shader storage buffer, the draw reads the buffer by
+// gl_InstanceID.
+class ComputeSimulation : public GpuSimulation {
+public:
+  ComputeSimulation(uint32_t amount, uint32_t seed);
+  ~ComputeSimulation() override;
+
+  void advance(int ticks, float step) override;
+  // Binds the star buffer to storage binding 0.
+  void bindForDraw() override;
+  std::vector<GpuStar> readBack() const override;
+  const char *vertexShaderSource() const override;
+  uint32_t storageBuffer() const override { return buffer; }
+
+private:
+  uint32_t buffer{0};
+  uint32_t program{0};
+};
+
+// For the GpuSimulation implementations: GLSL mix32/counterUniform matching
+// rng.hh, put a shader's body after it. Define PRECISE as precise where the
+// version has it (4.00 up) so the multiply and add are not fused.
+extern const char *const gpuCounterRandomSource;
+// Compiles sources as one shader of type and links it alone into a program
+// that captures varyings interleaved, if any. Exits on errors.
+uint32_t makeSimulationProgram(uint32_t type,
+                               std::initializer_list<const char *> sources,
+                               std::initializer_list<const char *> varyings =
+                                   {});
+
+// Sets the u_limit, u_keys, u_respawn and u_field uniforms a simulation
+// shader needs to respawn stars like StarSimulation does.
+void setRespawnUniforms(uint32_t program, uint32_t seed);
+
+// Invocations per work group of the star compute shaders.
+constexpr uint32_t STAR_GROUP_SIZE = 256;
+// Runs the bound compute program, local_size_x STAR_GROUP_SIZE, once per
+// star in as many dispatches as it takes, telling each where its slice
+// starts through the uniform u_first.
+void dispatchStars(uint32_t program, size_t stars);
+
+// Compute for backend Compute or Feedback.
+std::unique_ptr<GpuSimulation>
+makeGpuSimulation(SimBackend backend, uint32_t amount, uint32_t seed);
+
+// Runs the scalar CPU kernel and backend side by side on amount stars for
+// frames frames of one to three ticks of step, reading the GPU state back
+// after every frame. Prints what it finds and returns the number of stars
+// that ended up different.
+size_t verifyGpuSimulation(SimBackend backend, uint32_t amount,
+                           uint32_t seed, int frames, float step);
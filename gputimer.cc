@@ -0,0 +1,43 @@
+// clang-format off
+#include "khrplatform.h"
+#include "glad.h"
+// clang-format on
+#include "gputimer.hh"
+
+GpuTimer::GpuTimer() { glGenQueries(LATENCY, queries); }
+
+GpuTimer::~GpuTimer() { glDeleteQueries(LATENCY, queries); }
+
+void GpuTimer::collect(bool wait) {
+  while (pending > 0) {
+    GLuint query = queries[oldest];
+    if (!wait) {
+      GLint available{0};
+      glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available)
+        return;
+    }
+    GLuint64 nanoseconds{0};
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+    last = nanoseconds / 1.0e6f;
+    if (collectedCount < LATENCY)
+      collected[collectedCount++] = last;
+
+    oldest = (oldest + 1) % LATENCY;
+    pending--;
+    wait = false;
+  }
+}
+
+void GpuTimer::begin() {
+  // every query still in flight, only now is it worth waiting for one
+  if (pending == LATENCY)
+    collect(true);
+  glBeginQuery(GL_TIME_ELAPSED, queries[(oldest + pending) % LATENCY]);
+}
+
+void GpuTimer::end() {
+  glEndQuery(GL_TIME_ELAPSED);
+  pending++;
+  collect(false);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+
+// Times GL work with GL_TIME_ELAPSED queries without stalling the pipeline:
+// results are collected a few frames later, once the GPU got to them.
+class GpuTimer {
+public:
+  GpuTimer();
+  GpuTimer(const GpuTimer &) = delete;
+  GpuTimer &operator=(const GpuTimer &) = delete;
+  ~GpuTimer();
+
+  void begin();
+  void end();
+
+  // Most recent finished measurement in milliseconds, negative until the
+  // first one is in.
+  float lastMs() const { return last; }
+  // Milliseconds of every measurement collected since the last call.
+  template <typename Sink> void drain(Sink sink) {
+    for (int index = 0; index < collectedCount; ++index)
+      sink(collected[index]);
+    collectedCount = 0;
+  }
+
+private:
+  static constexpr int LATENCY = 4;
+
+  void collect(bool wait);
+
+  uint32_t queries[LATENCY];
+  float collected[LATENCY];
+  int collectedCount{0};
+  int oldest{0};
+  int pending{0};
+  float last{-1.0f};
+};
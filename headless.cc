@@ -0,0 +1,116 @@
+// clang-format off
+#include "khrplatform.h"
+#include "glad.h"
+// clang-format on
+#include "headless.hh"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static EGLDisplay openDisplay() {
+  auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+      "eglGetPlatformDisplayEXT");
+  EGLDisplay display = EGL_NO_DISPLAY;
+  if (getPlatformDisplay != nullptr) {
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                 EGL_DEFAULT_DISPLAY, nullptr);
+  }
+  if (display == EGL_NO_DISPLAY)
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  return display;
+}
+
+HeadlessContext::HeadlessContext(int width, int height) {
+  EGLDisplay eglDisplay = openDisplay();
+  if (eglDisplay == EGL_NO_DISPLAY ||
+      !eglInitialize(eglDisplay, nullptr, nullptr) ||
+      !eglBindAPI(EGL_OPENGL_API)) {
+    std::cerr << "Error could not open an EGL display" << std::endl;
+    exit(1);
+  }
+  display = eglDisplay;
+
+  // without a surface there is nothing the config has to match. some
+  // drivers answer the extension query with nothing, as if it was absent
+  const char *extensions = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+  EGLConfig config = EGL_NO_CONFIG_KHR;
+  if (extensions == nullptr ||
+      std::strstr(extensions, "EGL_KHR_no_config_context") == nullptr) {
+    EGLint wanted[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLint found{0};
+    eglChooseConfig(eglDisplay, wanted, &config, 1, &found);
+  }
+
+  for (EGLint version : {46, 33}) {
+    EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                           version / 10,
+                           EGL_CONTEXT_MINOR_VERSION,
+                           version % 10,
+                           EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                           EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                           EGL_NONE};
+    context = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, attributes);
+    if (context != EGL_NO_CONTEXT)
+      break;
+  }
+  if (context == EGL_NO_CONTEXT ||
+      !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    std::cerr << "Error could not create a surfaceless GL context"
+              << std::endl;
+    exit(1);
+  }
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+    std::cerr << " Error could not load glad " << std::endl;
+    exit(1);
+  }
+
+  glGenRenderbuffers(1, &colour);
+  glBindRenderbuffer(GL_RENDERBUFFER, colour);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, colour);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, depth);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cerr << "Error offscreen framebuffer of " << width << "x" << height
+              << " is incomplete" << std::endl;
+    exit(1);
+  }
+  glViewport(0, 0, width, height);
+}
+
+HeadlessContext::~HeadlessContext() {
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteRenderbuffers(1, &colour);
+  glDeleteRenderbuffers(1, &depth);
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglDestroyContext(display, context);
+  eglTerminate(display);
+}
+
+void HeadlessContext::present() { glFlush(); }
+
+bool writeFramebufferPpm(const char *path, int width, int height) {
+  std::vector<unsigned char> pixels((size_t)width * height * 3);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+  FILE *file = std::fopen(path, "wb");
+  if (file == nullptr)
+    return false;
+  std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+  // GL's rows start at the bottom
+  for (int row = height - 1; row >= 0; --row)
+    std::fwrite(&pixels[(size_t)row * width * 3], 3, width, file);
+  return std::fclose(file) == 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+
+// GL without a window system, for machines with no display and no GPU: a
+// surfaceless EGL context (Mesa's llvmpipe renders on the CPU) drawing into
+// a framebuffer object of width x height. Asks for GL 4.6 and falls back to
+// 3.3 like the window does, loads GL and leaves the framebuffer bound.
+// Exits when there is no EGL display or no context to be had.
+class HeadlessContext {
+public:
+  HeadlessContext(int width, int height);
+  HeadlessContext(const HeadlessContext &) = delete;
+  HeadlessContext &operator=(const HeadlessContext &) = delete;
+  ~HeadlessContext();
+
+  // Takes the place of swapping buffers, hands the frame to the driver.
+  void present();
+
+private:
+  void *display{nullptr};
+  void *context{nullptr};
+  uint32_t framebuffer{0};
+  uint32_t colour{0};
+  uint32_t depth{0};
+};
+
+// Writes the bound framebuffer's width x height pixels to path as a binary
+// PPM, top row first. Returns false when the file could not be written.
+bool writeFramebufferPpm(const char *path, int width, int height);
@@ -0,0 +1,86 @@
+#include "instance.hh"
+#include "config.hh"
+#include <algorithm>
+#include <cstring>
+
+float packedZMin() { return -zFar; }
+float packedDepth() { return 2.0f * zFar + 10.0f; }
+
+const char *instanceFormatName(InstanceFormat format) {
+  switch (format) {
+  case InstanceFormat::Packed16:
+    return "packed16";
+  case InstanceFormat::Split:
+    return "split";
+  case InstanceFormat::Compact:
+    break;
+  }
+  return "compact";
+}
+
+bool parseInstanceFormat(const char *name, InstanceFormat &format) {
+  for (InstanceFormat candidate : {InstanceFormat::Compact,
+                                   InstanceFormat::Packed16,
+                                   InstanceFormat::Split}) {
+    if (std::strcmp(name, instanceFormatName(candidate)) == 0) {
+      format = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t instanceStride(InstanceFormat format) {
+  switch (format) {
+  case InstanceFormat::Packed16:
+    return sizeof(PackedStarInstance);
+  case InstanceFormat::Split:
+    return sizeof(float);
+  case InstanceFormat::Compact:
+    break;
+  }
+  return sizeof(StarInstance);
+}
+
+float starScale(float z) { return z > zFar / 2.0f ? 0.1f : 1.0f; }
+
+static uint16_t unorm16(float value, float min, float range) {
+  float unit = std::clamp((value - min) / range, 0.0f, 1.0f);
+  return (uint16_t)(unit * 65535.0f + 0.5f);
+}
+
+void packInstance(InstanceFormat format, float x, float y, float z,
+                  void *out) {
+  if (format == InstanceFormat::Split) {
+    *static_cast<float *>(out) = z;
+  } else if (format == InstanceFormat::Packed16) {
+    auto *packed = static_cast<PackedStarInstance *>(out);
+    packed->x = unorm16(x, 0.0f, (float)SCREEN_WIDTH);
+    packed->y = unorm16(y, 0.0f, (float)SCREEN_HEIGHT);
+    packed->z = unorm16(z, packedZMin(), packedDepth());
+    packed->scale = unorm16(starScale(z), 0.0f, 1.0f);
+  } else {
+    *static_cast<StarInstance *>(out) = StarInstance{x, y, z, starScale(z)};
+  }
+}
+
+void packInstances(InstanceFormat format, const float *x, const float *y,
+                   const float *z, size_t begin, size_t end, void *out) {
+  if (format == InstanceFormat::Compact) {
+    auto *instances = static_cast<StarInstance *>(out);
+    for (size_t index = begin; index < end; ++index) {
+      instances[index - begin] =
+          StarInstance{x[index], y[index], z[index], starScale(z[index])};
+    }
+    return;
+  }
+  if (format == InstanceFormat::Split) {
+    std::memcpy(out, z + begin, (end - begin) * sizeof(float));
+    return;
+  }
+  auto *bytes = static_cast<unsigned char *>(out);
+  for (size_t index = begin; index < end; ++index) {
+    packInstance(format, x[index], y[index], z[index],
+                 bytes + (index - begin) * sizeof(PackedStarInstance));
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Per star data the vertex shader rebuilds the star's transform from:
+// a translation plus the x/y scale that turns near stars into streaks.
+enum class InstanceFormat {
+  Compact,  // 4 floats, 16 bytes
+  Packed16, // 4 normalised 16 bit values over the field bounds, 8 bytes
+  Split     // z only, 4 bytes, x/y in a static stream patched on respawn
+};
+
+struct StarInstance {
+  float x, y, z, scale;
+};
+
+struct PackedStarInstance {
+  uint16_t x, y, z, scale;
+};
+
+const char *instanceFormatName(InstanceFormat format);
+bool parseInstanceFormat(const char *name, InstanceFormat &format);
+size_t instanceStride(InstanceFormat format);
+
+// x/y scale of a star at depth z, the same rule the matrices used to apply.
+float starScale(float z);
+// z range Packed16 spreads its 16 bits over.
+float packedZMin();
+float packedDepth();
+
+// Writes stars [begin, end) in format into out, which is indexed from 0 at
+// begin. Pass nullptr for the x/y/z of a layout that lacks them.
+void packInstances(InstanceFormat format, const float *x, const float *y,
+                   const float *z, size_t begin, size_t end, void *out);
+void packInstance(InstanceFormat format, float x, float y, float z,
+                  void *out);
+
+// GL side, in instancegl.cc.
+
+// Points attribute 1 of the bound VAO at the bound GL_ARRAY_BUFFER, starting
+// offset bytes in.
+void setupInstanceAttributes(InstanceFormat format, size_t offset = 0);
+// Points attribute 2 of the bound VAO at the bound GL_ARRAY_BUFFER, the x/y
+// of InstanceFormat::Split as two floats per star.
+void setupStaticAttributes();
+// Sets the uniforms that turn attribute 1 back into world units.
+void setInstanceUniforms(uint32_t program, InstanceFormat format);
+
+// Vertex shader for Compact and Packed16, the instance format only changes
+// the attribute type and the u_instanceScale/u_instanceBias uniforms. Append
+// drawModeVertexSource to it.
+extern const char *const instanceVertexShaderSource;
+// The one above or the Split one, which takes z and x/y from attributes 1
+// and 2 and works the scale out from z.
+const char *instanceVertexShader(InstanceFormat format);
@@ -0,0 +1,78 @@
+// clang-format off
+#include "khrplatform.h"
+#include "glad.h"
+// clang-format on
+#include "instance.hh"
+#include "config.hh"
+
+void setupInstanceAttributes(InstanceFormat format, size_t offset) {
+  if (format == InstanceFormat::Packed16) {
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_SHORT, GL_TRUE,
+                          sizeof(PackedStarInstance), (void *)offset);
+  } else if (format == InstanceFormat::Split) {
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(float),
+                          (void *)offset);
+  } else {
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(StarInstance),
+                          (void *)offset);
+  }
+  glEnableVertexAttribArray(1);
+  glVertexAttribDivisor(1, 1);
+}
+
+void setupStaticAttributes() {
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float),
+                        (void *)0);
+  glEnableVertexAttribArray(2);
+  glVertexAttribDivisor(2, 1);
+}
+
+void setInstanceUniforms(uint32_t program, InstanceFormat format) {
+  int scale = glGetUniformLocation(program, "u_instanceScale");
+  int bias = glGetUniformLocation(program, "u_instanceBias");
+  if (format == InstanceFormat::Split) {
+    glUniform1f(glGetUniformLocation(program, "u_streakZ"), zFar / 2.0f);
+  } else if (format == InstanceFormat::Packed16) {
+    glUniform3f(scale, (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT,
+                packedDepth());
+    glUniform3f(bias, 0.0f, 0.0f, packedZMin());
+  } else {
+    glUniform3f(scale, 1.0f, 1.0f, 1.0f);
+    glUniform3f(bias, 0.0f, 0.0f, 0.0f);
+  }
+}
+
+const char *const instanceVertexShaderSource = R"(
+#version 330 core
+layout (location = 1) in vec4 aInstance; // position, x/y scale
+
+uniform vec3 u_instanceScale;
+uniform vec3 u_instanceBias;
+
+void placeStar(vec3 offset, float scale);
+
+void main()
+{
+    placeStar(u_instanceBias + aInstance.xyz * u_instanceScale, aInstance.w);
+}
+)";
+
+static const char *const splitInstanceVertexShaderSource = R"(
+#version 330 core
+layout (location = 1) in float aZ;
+layout (location = 2) in vec2 aXY;
+
+uniform float u_streakZ;
+
+void placeStar(vec3 offset, float scale);
+
+void main()
+{
+    placeStar(vec3(aXY, aZ), aZ > u_streakZ ? 0.1 : 1.0);
+}
+)";
+
+const char *instanceVertexShader(InstanceFormat format) {
+  return format == InstanceFormat::Split ? splitInstanceVertexShaderSource
+                                         : instanceVertexShaderSource;
+}
@@ -0,0 +1,203 @@
+// clang-format off
+#include "khrplatform.h"
+#include "glad.h"
+// clang-format on
+#include "instancestream.hh"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+constexpr GLuint64 FENCE_TIMEOUT = 1000000000; // ns, only to log stalls
+// dirty stars closer than this are uploaded together with the clean ones
+// between them, 512 bytes cost less than another glBufferSubData
+constexpr uint32_t PATCH_GAP = 64;
+
+const char *uploadModeName(UploadMode mode) {
+  return mode == UploadMode::Persistent ? "persistent" : "orphan";
+}
+
+bool parseUploadMode(const char *name, UploadMode &mode) {
+  for (UploadMode candidate : {UploadMode::Orphan, UploadMode::Persistent}) {
+    if (std::strcmp(name, uploadModeName(candidate)) == 0) {
+      mode = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+UploadMode supportedUploadMode(UploadMode wanted) {
+  if (wanted == UploadMode::Persistent &&
+      !(GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage)) {
+    std::cout << "no buffer storage, uploading with buffer orphaning"
+              << std::endl;
+    return UploadMode::Orphan;
+  }
+  return wanted;
+}
+
+InstanceStream::InstanceStream(UploadMode mode, size_t regionBytes)
+    : uploadMode(mode), regionSize(regionBytes) {
+  create();
+}
+
+InstanceStream::~InstanceStream() { destroy(); }
+
+void InstanceStream::create() {
+  glGenBuffers(1, &name);
+  glBindBuffer(GL_ARRAY_BUFFER, name);
+  if (uploadMode == UploadMode::Persistent) {
+    GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, regionSize * REGIONS, nullptr, flags);
+    mapped = static_cast<unsigned char *>(
+        glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * REGIONS, flags));
+  } else {
+    glBufferData(GL_ARRAY_BUFFER, regionSize, nullptr, GL_DYNAMIC_DRAW);
+  }
+  region = 0;
+}
+
+void InstanceStream::destroy() {
+  for (auto &fence : fences) {
+    if (fence != nullptr) {
+      glDeleteSync(static_cast<GLsync>(fence));
+      fence = nullptr;
+    }
+  }
+  if (mapped != nullptr) {
+    glBindBuffer(GL_ARRAY_BUFFER, name);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    mapped = nullptr;
+  }
+  glDeleteBuffers(1, &name);
+  name = 0;
+}
+
+void InstanceStream::resize(size_t regionBytes) {
+  if (regionBytes <= regionSize)
+    return;
+  if (uploadMode == UploadMode::Persistent) {
+    // storage is immutable, all regions go and so must every draw using them
+    destroy();
+    regionSize = regionBytes;
+    create();
+  } else {
+    regionSize = regionBytes;
+    glBindBuffer(GL_ARRAY_BUFFER, name);
+    glBufferData(GL_ARRAY_BUFFER, regionSize, nullptr, GL_DYNAMIC_DRAW);
+  }
+}
+
+void InstanceStream::waitForRegion() {
+  GLsync fence = static_cast<GLsync>(fences[region]);
+  if (fence == nullptr)
+    return;
+
+  GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  while (status == GL_TIMEOUT_EXPIRED) {
+    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+    if (status == GL_TIMEOUT_EXPIRED)
+      std::cerr << "Error waiting on instance region " << region << std::endl;
+  }
+  glDeleteSync(fence);
+  fences[region] = nullptr;
+}
+
+void *InstanceStream::begin(size_t bytes) {
+  glBindBuffer(GL_ARRAY_BUFFER, name);
+  if (uploadMode == UploadMode::Persistent && mapped != nullptr) {
+    region = (region + 1) % REGIONS;
+    waitForRegion();
+    return mapped + region * regionSize;
+  }
+  return glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes,
+                          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+}
+
+void InstanceStream::end(size_t bytes, const void *fallback) {
+  if (uploadMode == UploadMode::Persistent && mapped != nullptr) {
+    // coherent mapping, nothing to flush
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, name);
+  GLint isMapped{GL_FALSE};
+  glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_MAPPED, &isMapped);
+  if (!isMapped || glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE) {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, fallback);
+  }
+}
+
+void InstanceStream::fence() {
+  if (uploadMode != UploadMode::Persistent)
+    return;
+  if (fences[region] != nullptr)
+    glDeleteSync(static_cast<GLsync>(fences[region]));
+  fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void DirtyRanges::mark(uint32_t begin, uint32_t end) {
+  if (begin >= end)
+    return;
+  if (!ranges.empty() && ranges.back().end == begin)
+    ranges.back().end = end;
+  else
+    ranges.push_back({begin, end});
+}
+
+static bool startsBefore(const DirtyRanges::Range &a,
+                         const DirtyRanges::Range &b) {
+  return a.begin < b.begin;
+}
+
+std::vector<DirtyRanges::Range> DirtyRanges::take(uint32_t gap) {
+  if (!std::is_sorted(ranges.begin(), ranges.end(), startsBefore))
+    std::sort(ranges.begin(), ranges.end(), startsBefore);
+  std::vector<Range> merged;
+  for (const Range &range : ranges) {
+    if (!merged.empty() && range.begin <= merged.back().end + gap)
+      merged.back().end = std::max(merged.back().end, range.end);
+    else
+      merged.push_back(range);
+  }
+  ranges.clear();
+  return merged;
+}
+
+StaticInstances::StaticInstances() { glGenBuffers(1, &name); }
+
+StaticInstances::~StaticInstances() { glDeleteBuffers(1, &name); }
+
+void StaticInstances::resize(size_t stars, const float *x, const float *y) {
+  if (stars > capacity) {
+    capacity = std::max(stars, capacity * 2);
+    interleaved.resize(capacity * 2);
+    glBindBuffer(GL_ARRAY_BUFFER, name);
+    glBufferData(GL_ARRAY_BUFFER, capacity * 2 * sizeof(float), nullptr,
+                 GL_DYNAMIC_DRAW);
+    // the new storage starts out undefined, all of it needs uploading
+    dirty.mark(0, (uint32_t)count);
+  }
+  for (size_t index = count; index < stars; ++index) {
+    interleaved[index * 2] = x[index];
+    interleaved[index * 2 + 1] = y[index];
+  }
+  if (stars > count)
+    dirty.mark((uint32_t)count, (uint32_t)stars);
+  count = stars;
+}
+
+size_t StaticInstances::flush() {
+  if (dirty.empty())
+    return 0;
+  size_t bytes = 0;
+  glBindBuffer(GL_ARRAY_BUFFER, name);
+  for (const DirtyRanges::Range &range : dirty.take(PATCH_GAP)) {
+    size_t offset = range.begin * 2 * sizeof(float);
+    size_t size = (range.end - range.begin) * 2 * sizeof(float);
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size,
+                    &interleaved[range.begin * 2]);
+    bytes += size;
+  }
+  return bytes;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class UploadMode {
+  Orphan,    // map with GL_MAP_INVALIDATE_BUFFER_BIT every frame
+  Persistent // persistently mapped ring of regions guarded by fences
+};
+
+const char *uploadModeName(UploadMode mode);
+bool parseUploadMode(const char *name, UploadMode &mode);
+// Persistent needs GL 4.4 or ARB_buffer_storage, falls back to Orphan.
+UploadMode supportedUploadMode(UploadMode wanted);
+
+// The instance buffer and how each frame's instances get into it. In the
+// persistent mode the buffer is created once with glBufferStorage, split in
+// REGIONS parts and kept mapped: the CPU writes frame N into one part while
+// the GPU may still read the two before it, and a fence per part makes sure
+// a part is only reused once the draw reading it has finished. No driver
+// allocation and no staging copy per frame.
+class InstanceStream {
+public:
+  static constexpr int REGIONS = 3;
+
+  InstanceStream(UploadMode mode, size_t regionBytes);
+  InstanceStream(const InstanceStream &) = delete;
+  InstanceStream &operator=(const InstanceStream &) = delete;
+  ~InstanceStream();
+
+  // Reallocates for a bigger region. The buffer name may change, so point the
+  // VAO at buffer() again afterwards.
+  void resize(size_t regionBytes);
+
+  // Where this frame's instances go. Returns nullptr when mapping failed,
+  // end then uploads from fallback instead.
+  void *begin(size_t bytes);
+  void end(size_t bytes, const void *fallback);
+  // Call after the draw that read the current region.
+  void fence();
+
+  uint32_t buffer() const { return name; }
+  UploadMode mode() const { return uploadMode; }
+  // First instance of the current region, pass it as the draw's baseinstance.
+  uint32_t baseInstance(size_t stride) const {
+    return (uint32_t)(region * regionSize / stride);
+  }
+  // Byte offset of the current region, for pointing an attribute at it when
+  // other instanced attributes must not be shifted by a base instance.
+  size_t offset() const { return region * regionSize; }
+
+private:
+  void create();
+  void destroy();
+  void waitForRegion();
+
+  UploadMode uploadMode;
+  size_t regionSize;
+  uint32_t name{0};
+  unsigned char *mapped{nullptr};
+  void *fences[REGIONS]{};
+  int region{0};
+};
+
+// Stars changed since the last upload, as [begin, end) index ranges.
+// Marking in ascending order, as the simulation reports respawns, extends
+// the last range instead of adding one per star.
+class DirtyRanges {
+public:
+  struct Range {
+    uint32_t begin, end;
+  };
+
+  void mark(uint32_t index) { mark(index, index + 1); }
+  void mark(uint32_t begin, uint32_t end);
+  // Sorts the ranges and merges those less than gap stars apart, uploading
+  // a few clean stars costs less than another call. Then forgets them.
+  std::vector<Range> take(uint32_t gap);
+  bool empty() const { return ranges.empty(); }
+
+private:
+  std::vector<Range> ranges;
+};
+
+// Per star data that only changes when a star respawns, the x/y of
+// InstanceFormat::Split as two floats per star. Changes go to a CPU copy
+// and are tracked as dirty ranges, flush() uploads only those, merged
+// into as few glBufferSubData calls as makes sense.
+class StaticInstances {
+public:
+  StaticInstances();
+  StaticInstances(const StaticInstances &) = delete;
+  StaticInstances &operator=(const StaticInstances &) = delete;
+  ~StaticInstances();
+
+  // Takes stars up to count from x/y when growing, shrinking keeps them.
+  // The buffer name stays the same even when its storage grows.
+  void resize(size_t count, const float *x, const float *y);
+  void set(uint32_t index, float x, float y) {
+    interleaved[index * 2] = x;
+    interleaved[index * 2 + 1] = y;
+    dirty.mark(index);
+  }
+  // Uploads the dirty ranges, returns how many bytes that was.
+  size_t flush();
+
+  uint32_t buffer() const { return name; }
+
+private:
+  uint32_t name{0};
+  size_t count{0};
+  size_t capacity{0};
+  std::vector<float> interleaved;
+  DirtyRanges dirty;
+};
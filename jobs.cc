@@ -0,0 +1,188 @@
+#include "jobs.hh"
+#include "trace.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+constexpr int SPIN_LIMIT = 1 << 10;
+constexpr int YIELD_LIMIT = 64;
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+size_t JobGraph::add(Work work) {
+  nodes.push_back(Node{std::move(work), {}, 0});
+  return nodes.size() - 1;
+}
+
+void JobGraph::precede(size_t before, size_t after) {
+  nodes[before].successors.push_back(after);
+  nodes[after].dependencies++;
+}
+
+JobScheduler::JobScheduler(unsigned participants) {
+  if (participants < 1)
+    participants = 1;
+  for (size_t self = 0; self < participants; ++self) {
+    deques.push_back(std::make_unique<Deque>());
+  }
+  for (size_t self = 1; self < participants; ++self) {
+    threads.emplace_back([this, self] { workerLoop(self); });
+  }
+}
+
+JobScheduler::~JobScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    generation.fetch_add(1, std::memory_order_release);
+  }
+  wake.notify_all();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+template <typename Ready>
+void JobScheduler::spinThenPark(Ready ready, std::condition_variable &cv) {
+  for (int spin = 0; spin < SPIN_LIMIT; ++spin) {
+    if (ready())
+      return;
+    cpuRelax();
+  }
+  // give an oversubscribed core to whoever we are waiting for before parking
+  for (int spin = 0; spin < YIELD_LIMIT; ++spin) {
+    if (ready())
+      return;
+    std::this_thread::yield();
+  }
+  // publishers notify under the mutex, so checking again here can't miss it
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, ready);
+}
+
+void JobScheduler::push(size_t self, size_t job) {
+  std::lock_guard<std::mutex> lock(deques[self]->mutex);
+  deques[self]->jobs.push_back(job);
+}
+
+bool JobScheduler::pop(size_t self, size_t &job) {
+  Deque &own = *deques[self];
+  std::lock_guard<std::mutex> lock(own.mutex);
+  if (own.jobs.empty())
+    return false;
+  job = own.jobs.back();
+  own.jobs.pop_back();
+  return true;
+}
+
+bool JobScheduler::steal(size_t self, size_t &job) {
+  for (size_t offset = 1; offset < deques.size(); ++offset) {
+    Deque &victim = *deques[(self + offset) % deques.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      job = victim.jobs.front();
+      victim.jobs.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobScheduler::execute(size_t self, size_t job) {
+  JobGraph::Node &node = graph->nodes[job];
+  node.work();
+
+  for (size_t successor : node.successors) {
+    if (dependencies[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      push(self, successor);
+    }
+  }
+  if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    std::lock_guard<std::mutex> lock(mutex);
+    done.notify_all();
+  }
+}
+
+void JobScheduler::participate(size_t self) {
+  int misses{0};
+
+  while (remaining.load(std::memory_order_acquire) > 0) {
+    size_t job;
+    if (pop(self, job) || steal(self, job)) {
+      execute(self, job);
+      misses = 0;
+    } else if (++misses < SPIN_LIMIT) {
+      cpuRelax();
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobScheduler::workerLoop(size_t self) {
+  uint64_t seen{0};
+  STARFIELD_TRACE_THREAD("job worker");
+
+  for (;;) {
+    spinThenPark(
+        [&] { return generation.load(std::memory_order_acquire) != seen; },
+        wake);
+    seen = generation.load(std::memory_order_acquire);
+    if (stopping)
+      return;
+
+    busy.fetch_add(1, std::memory_order_acq_rel);
+    participate(self);
+    if (busy.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(mutex);
+      done.notify_all();
+    }
+  }
+}
+
+void JobScheduler::run(JobGraph &graph) {
+  size_t count = graph.nodes.size();
+  if (count == 0)
+    return;
+
+  this->graph = &graph;
+  if (dependencyCapacity < count) {
+    dependencies = std::make_unique<std::atomic<int>[]>(count);
+    dependencyCapacity = count;
+  }
+  for (size_t job = 0; job < count; ++job) {
+    dependencies[job].store(graph.nodes[job].dependencies,
+                            std::memory_order_relaxed);
+  }
+  remaining.store(count, std::memory_order_release);
+
+  // deal the roots out round robin so every thread starts with local work
+  size_t next{0};
+  for (size_t job = 0; job < count; ++job) {
+    if (graph.nodes[job].dependencies == 0) {
+      push(next, job);
+      next = (next + 1) % deques.size();
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation.fetch_add(1, std::memory_order_release);
+  }
+  wake.notify_all();
+
+  participate(0);
+  // the graph has to outlive every worker still looking at it
+  spinThenPark(
+      [&] {
+        return remaining.load(std::memory_order_acquire) == 0 &&
+               busy.load(std::memory_order_acquire) == 0;
+      },
+      done);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A set of jobs and the order they have to run in. Build it once and run it
+// every frame, the scheduler resets the dependency counts on each run.
+class JobGraph {
+public:
+  using Work = std::function<void()>;
+
+  // Returns the id to pass to precede.
+  size_t add(Work work);
+  // after may only start once before has finished.
+  void precede(size_t before, size_t after);
+  size_t size() const { return nodes.size(); }
+  void clear() { nodes.clear(); }
+
+private:
+  friend class JobScheduler;
+  struct Node {
+    Work work;
+    std::vector<size_t> successors;
+    int dependencies{0};
+  };
+  std::vector<Node> nodes;
+};
+
+// Runs job graphs on a fixed set of worker threads created once at startup.
+// Every thread owns a deque: jobs made ready by a finished job go to the back
+// of the finishing thread's deque and run there next while their inputs are
+// still in cache, idle threads steal from the front of the others. The caller
+// of run joins in as one of the threads. Idle threads spin briefly, yield and
+// then park, so nothing is spawned per frame.
+class JobScheduler {
+public:
+  explicit JobScheduler(unsigned participants);
+  JobScheduler(const JobScheduler &) = delete;
+  JobScheduler &operator=(const JobScheduler &) = delete;
+  ~JobScheduler();
+
+  // Number of threads running jobs, the caller of run included.
+  size_t size() const { return threads.size() + 1; }
+
+  // Returns once every job in graph has run.
+  void run(JobGraph &graph);
+
+private:
+  struct alignas(64) Deque {
+    std::mutex mutex;
+    std::deque<size_t> jobs;
+  };
+
+  template <typename Ready>
+  void spinThenPark(Ready ready, std::condition_variable &cv);
+  void push(size_t self, size_t job);
+  bool pop(size_t self, size_t &job);
+  bool steal(size_t self, size_t &job);
+  void execute(size_t self, size_t job);
+  void participate(size_t self);
+  void workerLoop(size_t self);
+
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<Deque>> deques;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::atomic<uint64_t> generation{0};
+  std::atomic<size_t> remaining{0};
+  std::atomic<size_t> busy{0};
+  bool stopping{false};
+
+  JobGraph *graph{nullptr};
+  std::unique_ptr<std::atomic<int>[]> dependencies;
+  size_t dependencyCapacity{0};
+};
@@ -3,51 +3,40 @@
 #include "glad.h" // must be before glfw.h
 #include <GLFW/glfw3.h>
 // clang-format on
+#include "bench.hh"
+#include "budget.hh"
+#include "config.hh"
+#include "cull.hh"
+#include "drawmode.hh"
+#include "gpusim.hh"
+#include "glstate.hh"
+#include "gputimer.hh"
+#include "headless.hh"
+#include "instance.hh"
+#include "instancestream.hh"
+#include "jobs.hh"
+#include "options.hh"
+#include "simthread.hh"
+#include "simulation.hh"
+#include "stateless.hh"
+#include "timestep.hh"
+#include "trace.hh"
+#include "uploadthread.hh"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
 #include <iostream>
-#include <random>
+#include <memory>
+#include <string>
 #include <vector>
 
-constexpr int32_t SCREEN_WIDTH = 1600;
-constexpr int32_t SCREEN_HEIGHT = 1100;
-constexpr float fov = glm::radians(90.0f);
-const float zFar = (SCREEN_WIDTH / 2.0) / tanf64(fov / 2.0f);
-constexpr auto vertexShaderSource = R"(
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in mat4 aOffset;
-
-out vec4 mycolour;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform vec2 u_resolution;
-
-void main()
-{
-    gl_Position = projection * view * model * aOffset * vec4(aPos, 1.0);
-
-    vec3 ndc = gl_Position.xyz / gl_Position.w;
-    mycolour = vec4(1.0,1.0,1.0,1.0)*ndc.z;
-}
-)";
-
-constexpr auto fragmentShaderSource = R"(
-#version 330 core
-out vec4 FragColor;
-in vec4 mycolour;
-void main()
-{
-    FragColor = vec4(mycolour);
-} )";
-
 void APIENTRY glDebugOutput(GLenum source, GLenum type, unsigned int id,
                             GLenum severity, [[maybe_unused]] GLsizei length,
                             const char *message,
@@ -71,6 +60,12 @@ unsigned int loadShaders(const char *shaderSource, GLenum shaderType) {
   return shader;
 }
 
+// star vertex shaders end in the placeStar of the draw mode
+unsigned int loadStarShader(const char *shaderSource, DrawMode mode) {
+  std::string source = std::string(shaderSource) + drawModeVertexSource(mode);
+  return loadShaders(source.c_str(), GL_VERTEX_SHADER);
+}
+
 unsigned int makeShaderProgram(uint32_t vertexShader, uint32_t fragmentShader) {
   unsigned int shaderProgram;
   shaderProgram = glCreateProgram();
@@ -95,8 +90,51 @@ void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action,
     glfwSetWindowShouldClose(window, GLFW_TRUE);
 }
 
+// the render loop picks up size changes from here instead of asking glfw
+// every frame
+static int framebufferWidth = SCREEN_WIDTH;
+static int framebufferHeight = SCREEN_HEIGHT;
+static bool framebufferResized = true;
+
 void framebuffer_size_callback(GLFWwindow * /*window*/, int width, int height) {
   glViewport(0, 0, width, height);
+  framebufferWidth = width;
+  framebufferHeight = height;
+  framebufferResized = true;
+}
+
+// Swaps and polls the window, or with no window hands the frame to the
+// headless context.
+void presentFrame(GLFWwindow *window, HeadlessContext *headless) {
+  if (window) {
+    {
+      STARFIELD_TRACE("swap");
+      glfwSwapBuffers(window);
+    }
+    //  Keep running
+    STARFIELD_TRACE("poll events");
+    glfwPollEvents();
+  } else {
+    STARFIELD_TRACE("present");
+    headless->present();
+  }
+}
+
+// Writes the trace recorded so far and says where it went.
+void saveTrace(const char *path) {
+  if (writeTrace(path))
+    std::cout << "trace: " << path << std::endl;
+  else
+    std::cerr << "Error could not write " << path << std::endl;
+}
+
+void closeWindow(GLFWwindow *window,
+                 std::unique_ptr<HeadlessContext> &headless) {
+  if (window) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+  }
+  headless.reset();
 }
 
 void processInput(GLFWwindow *window) {
@@ -104,35 +142,68 @@ void processInput(GLFWwindow *window) {
     glfwSetWindowShouldClose(window, true);
 }
 
-void camera(uint32_t shaderId, [[maybe_unused]] float dist) {
-  glm::mat4 view = glm::mat4(1.0f);
-
+glm::mat4 cameraView() {
   // float zFar = (SCREEN_WIDTH / 2.0f) / tanf64(fov / 2.0f); // was 90.0f
   glm::vec3 cameraPos =
       glm::vec3(SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f, zFar);
   glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
   glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
-  view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-
-  int modelView = glGetUniformLocation(shaderId, "view");
-  glUniformMatrix4fv(modelView, 1, GL_FALSE, glm::value_ptr(view));
+  return glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
 }
 
-std::vector<glm::vec3> generateStarOffsets(uint32_t amount) {
-  std::random_device r;
-  std::default_random_engine e1(r());
-  std::uniform_int_distribution<int> xrand(0, (float)SCREEN_WIDTH);
-  std::uniform_int_distribution<int> yrand(0, (float)SCREEN_HEIGHT);
-  std::uniform_int_distribution<int> zrand(-zFar, zFar);
-  std::vector<glm::vec3> retVal;
-
-  for (float index = 0; index < (float)amount; ++index) {
-    glm::vec3 vertex((float)xrand(e1), (float)yrand(e1), (float)zrand(e1));
-    // std::cout << vertex.x << " " << vertex.y << " " << vertex.z << std::endl;
+// Draws the stateless starfield frozen at time zero for frames frames in
+// every draw mode and prints what each took. The picture is the same in all
+// modes, only the vertex and fragment work differs.
+void benchmarkDrawModes(GLFWwindow *window, HeadlessContext *headless,
+                        unsigned int VAO,
+                        const glm::mat4 &projection, uint32_t stars,
+                        uint32_t seed, int frames) {
+  if (window)
+    glfwSwapInterval(0);
+  CameraBlock camera;
+  camera.update(cameraView(), projection);
+  std::cout << "draw benchmark: " << stars << " stars, " << frames
+            << " frames per mode" << std::endl;
+  for (DrawMode mode : {DrawMode::Quads, DrawMode::Points, DrawMode::Strip}) {
+    auto program = makeShaderProgram(
+        loadStarShader(statelessVertexShaderSource, mode),
+        loadShaders(drawModeFragmentShaderSource(mode), GL_FRAGMENT_SHADER));
+    glUseProgram(program);
+    glm::mat4 model = glm::mat4(1.0f);
+    glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE,
+                       glm::value_ptr(model));
+    camera.attach(program);
+    setStatelessUniforms(program, seed, statelessClock(0.0));
+    setDrawModeUniforms(program, projection[1][1], SCREEN_HEIGHT);
+    glBindVertexArray(VAO);
 
-    retVal.push_back(vertex);
+    GpuTimer timer;
+    double gpuMs{0.0};
+    int measured{0};
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      timer.begin();
+      drawStars(mode, stars, 0);
+      timer.end();
+      timer.drain([&](float ms) {
+        gpuMs += ms;
+        measured++;
+      });
+      presentFrame(window, headless);
+    }
+    glFinish();
+    float frameMs = std::chrono::duration<float, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count() /
+                    frames;
+
+    std::cout << "  " << drawModeName(mode) << ": "
+              << (size_t)drawModeVertices(mode) * stars << " vertices, "
+              << (measured > 0 ? gpuMs / measured : 0.0) << " ms gpu, "
+              << frameMs << " ms per frame" << std::endl;
+    glDeleteProgram(program);
   }
-  return retVal;
 }
 
 std::vector<glm::vec3> generateStaticOffsets() {
@@ -145,10 +216,12 @@ std::vector<glm::vec3> generateStaticOffsets() {
   return retVal;
 }
 
-int main() {
-  std::random_device r;
-  std::default_random_engine e1(r());
-
+int main(int argc, char **argv) {
+  Options options = parseOptions(argc, argv);
+  // before anything slow, a SIGUSR1 during startup must not end the program
+  STARFIELD_TRACE_THREAD("main");
+  if (tracingEnabled())
+    installTraceSignal();
   // clang-format off
   std::vector<float> star = {
       -0.50f, -0.50f, 0.0f,
@@ -160,71 +233,125 @@ int main() {
   };
   // clang-format on
 
-  auto starOffsets = generateStarOffsets(100000);
-  std::vector<glm::mat4> offsetMatrices;
+  size_t starCount = options.stars;
 
-  for (const auto &vec : starOffsets) {
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, vec);
-    offsetMatrices.push_back(model);
-  }
-
-  [[maybe_unused]] float deltaTime =
-      0.0f;               // Time between current frame and last frame
+  float deltaTime = 0.0f; // Time between current frame and last frame
   float lastFrame = 0.0f; // Time of last frame
 
   srand(time(NULL));
 
-  if (!glfwInit()) {
-    // Initialization failed
-    std::cerr << "Error could not init glfw!" << std::endl;
-    exit(1);
-  }
+  // without a window everything draws into the headless context's
+  // framebuffer, and no glfw call is made at all
+  GLFWwindow *window = nullptr;
+  std::unique_ptr<HeadlessContext> headless;
+  if (options.headless) {
+    headless = std::make_unique<HeadlessContext>(options.width, options.height);
+  } else {
+    if (!glfwInit()) {
+      // Initialization failed
+      std::cerr << "Error could not init glfw!" << std::endl;
+      exit(1);
+    }
 
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-  glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
-  glfwWindowHint(GLFW_DOUBLEBUFFER, GL_TRUE);
-  glfwSetErrorCallback(error_callback);
-
-  GLFWwindow *window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "My Title",
-                                        nullptr, nullptr);
-  if (!window) {
-    std::cerr << "Error could not create window" << std::endl;
-    exit(1);
-    // Window or OpenGL context creation failed
-  }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+    glfwWindowHint(GLFW_DOUBLEBUFFER, GL_TRUE);
+    glfwSetErrorCallback(error_callback);
+
+    window = glfwCreateWindow(options.width, options.height, "My Title",
+                              nullptr, nullptr);
+    if (!window) {
+      // everything past 3.3 is optional, older drivers get the fallbacks
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+      window = glfwCreateWindow(options.width, options.height, "My Title",
+                                nullptr, nullptr);
+    }
+    if (!window) {
+      std::cerr << "Error could not create window" << std::endl;
+      exit(1);
+      // Window or OpenGL context creation failed
+    }
 
-  glfwMakeContextCurrent(window);
-  glfwSetKeyCallback(window, key_callback);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwMakeContextCurrent(window);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    std::cerr << " Error could not load glad " << std::endl;
-    glfwDestroyWindow(window);
-    glfwTerminate();
-    exit(1);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      std::cerr << " Error could not load glad " << std::endl;
+      glfwDestroyWindow(window);
+      glfwTerminate();
+      exit(1);
+    }
+    // benchmarks measure the frame, not the display's refresh
+    glfwSwapInterval(options.benchFrames > 0 ? 0 : 1);
   }
-  glfwSwapInterval(1);
+  if (options.countGlCalls)
+    countGlCalls();
 
-  glEnable(GL_DEBUG_OUTPUT);
-  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
   //  Enable depth test
   glEnable(GL_DEPTH_TEST);
   // Accept fragment if it closer to the camera than the former one
   glDepthFunc(GL_LESS);
-  glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+  glViewport(0, 0, options.width, options.height);
+  framebufferWidth = options.width;
+  framebufferHeight = options.height;
 
   int flags;
   glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
-  if (flags & GL_CONTEXT_FLAG_DEBUG_BIT) {
+  if ((flags & GL_CONTEXT_FLAG_DEBUG_BIT) &&
+      (GLAD_GL_VERSION_4_3 || GLAD_GL_KHR_debug)) {
     std::cout << "debug mode enabled!" << std::endl;
+    glEnable(GL_DEBUG_OUTPUT);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
     glDebugMessageCallback(glDebugOutput, nullptr);
     glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr,
                           GL_TRUE);
   }
 
+  if (options.verifyGpuFrames > 0) {
+    SimBackend checked = supportedSimBackend(
+        options.backend == SimBackend::Cpu ? SimBackend::Compute
+                                           : options.backend);
+    size_t different = verifyGpuSimulation(checked, options.stars,
+                                           options.seed,
+                                           options.verifyGpuFrames,
+                                           STAR_SPEED / options.simHz);
+    closeWindow(window, headless);
+    exit(different == 0 ? 0 : 1);
+  }
+
+  // with a gpu backend the stars only exist on the gpu, the cpu simulation
+  // and instance upload are left out altogether. stateless stars exist
+  // nowhere, the shader works them out from the clock
+  SimBackend backend = options.stateless
+                           ? SimBackend::Cpu
+                           : supportedSimBackend(options.backend);
+  std::unique_ptr<StarSimulation> simulation;
+  std::unique_ptr<GpuSimulation> gpuSimulation;
+  if (backend != SimBackend::Cpu) {
+    gpuSimulation = makeGpuSimulation(backend, options.stars, options.seed);
+  } else if (!options.stateless) {
+    simulation = std::make_unique<StarSimulation>(
+        options.stars, options.isa, options.seed, options.instanceFormat,
+        options.depthRing);
+  }
+
+  // culling reads the stars from a storage buffer, only the compute backend
+  // keeps them in one
+  std::unique_ptr<StarCuller> culler;
+  if (options.cull) {
+    if (gpuSimulation && gpuSimulation->storageBuffer() != 0) {
+      culler = std::make_unique<StarCuller>(starCount);
+      std::cout << "frustum culling on the gpu, indirect draws" << std::endl;
+    } else {
+      std::cout << "culling needs the compute simulation, drawing every star"
+                << std::endl;
+    }
+  }
+
   unsigned int VAO;
   glGenVertexArrays(1, &VAO);
 
@@ -243,31 +370,33 @@ int main() {
 
   // instance data
 
-  unsigned int instanceVBO;
-  glGenBuffers(1, &instanceVBO);
-  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-  glBufferData(GL_ARRAY_BUFFER, offsetMatrices.size() * sizeof(glm::mat4),
-               nullptr /*offsetMatrices.data()*/, GL_DYNAMIC_DRAW);
-  // here we have to do this 4 times since vec 4 is max per attrib pointer
-  //  and our matrix is 4x4
-
-  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 1 * sizeof(glm::mat4),
-                        (void *)0);
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 1 * sizeof(glm::mat4),
-                        (void *)(1 * sizeof(glm::vec4)));
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 1 * sizeof(glm::mat4),
-                        (void *)(2 * sizeof(glm::vec4)));
-  glEnableVertexAttribArray(3);
-  glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 1 * sizeof(glm::mat4),
-                        (void *)(3 * sizeof(glm::vec4)));
-  glEnableVertexAttribArray(4);
-
-  glVertexAttribDivisor(1, 1);
-  glVertexAttribDivisor(2, 1);
-  glVertexAttribDivisor(3, 1);
-  glVertexAttribDivisor(4, 1);
+  // sized for the most stars seen so far, the adaptive star count only
+  // reallocates it when growing past that
+  size_t instanceCapacity = starCount;
+  // the upload thread brings its own buffers
+  bool threadedUpload = options.uploadThread && options.simulationThread &&
+                        simulation && !options.stateless;
+  std::unique_ptr<InstanceStream> instances;
+  if (simulation && !threadedUpload) {
+    instances = std::make_unique<InstanceStream>(
+        supportedUploadMode(options.upload),
+        instanceCapacity * simulation->stride());
+    std::cout << "instance upload: " << uploadModeName(instances->mode())
+              << std::endl;
+    // one vec4 per star, the vertex shader rebuilds the transform from it
+    setupInstanceAttributes(simulation->format());
+  }
+
+  // split instances only stream z, x/y sit in their own buffer and change
+  // when a star respawns
+  std::unique_ptr<StaticInstances> staticInstances;
+  if (simulation && simulation->format() == InstanceFormat::Split) {
+    staticInstances = std::make_unique<StaticInstances>();
+    staticInstances->resize(starCount, simulation->stars().x(),
+                            simulation->stars().y());
+    staticInstances->flush();
+    setupStaticAttributes();
+  }
 
   glBindBuffer(GL_ARRAY_BUFFER, 0);
 
@@ -278,98 +407,401 @@ int main() {
 
   // end instance data
 
-  auto vertexShader = loadShaders(vertexShaderSource, GL_VERTEX_SHADER);
-  auto fragmentShader = loadShaders(fragmentShaderSource, GL_FRAGMENT_SHADER);
-  auto shaderProgram = makeShaderProgram(vertexShader, fragmentShader);
+  // stateless positions come from the time uniform and gpu simulations draw
+  // from their own buffers, either way the instance buffer goes unused
+  const char *vertexSource = instanceVertexShader(options.instanceFormat);
+  if (options.stateless)
+    vertexSource = statelessVertexShaderSource;
+  else if (culler) // the visible stars come out as compact instances
+    vertexSource = instanceVertexShaderSource;
+  else if (gpuSimulation)
+    vertexSource = gpuSimulation->vertexShaderSource();
+  auto shaderProgram = makeShaderProgram(
+      loadStarShader(vertexSource, options.draw),
+      loadShaders(drawModeFragmentShaderSource(options.draw),
+                  GL_FRAGMENT_SHADER));
+  glUseProgram(shaderProgram);
+  // points size themselves in the vertex shader
+  glEnable(GL_PROGRAM_POINT_SIZE);
+  std::cout << "drawing " << drawModeName(options.draw) << ", "
+            << drawModeVertices(options.draw) << " vertices per star"
+            << std::endl;
+  if (options.stateless) {
+    setStatelessUniforms(shaderProgram, options.seed, statelessClock(0.0));
+    std::cout << "stateless starfield, nothing simulated on the cpu"
+              << std::endl;
+  } else if (gpuSimulation) {
+    if (culler)
+      setInstanceUniforms(shaderProgram, InstanceFormat::Compact);
+    else
+      gpuSimulation->setDrawUniforms(shaderProgram);
+    std::cout << "stars simulated on the gpu (" << simBackendName(backend)
+              << "), nothing uploaded per frame" << std::endl;
+  } else {
+    setInstanceUniforms(shaderProgram, simulation->format());
+    std::cout << "instance format: "
+              << instanceFormatName(simulation->format()) << ", "
+              << simulation->stride() << " bytes per star" << std::endl;
+  }
 
   // float zFar = (SCREEN_WIDTH / 2.0) / tanf64(fov / 2.0f) + 10.0f; // 100.0f
   glm::mat4 projection = glm::perspective(
-      fov, (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, zFar + 10.0f);
+      fov, (float)options.width / (float)options.height, 0.1f, zFar + 10.0f);
 
-  std::uniform_int_distribution<int> zrand(-zFar, 100.0);
+  if (options.drawBenchFrames > 0) {
+    benchmarkDrawModes(window, headless.get(), VAO, projection, options.stars,
+                       options.seed, options.drawBenchFrames);
+    closeWindow(window, headless);
+    exit(0);
+  }
 
+  // the frame loop only sets what changes: the model matrix every frame,
+  // the point size on resize. view and projection sit in the camera block
+  GlState glState;
+  glState.useProgram(shaderProgram);
+  UniformCache uniforms(shaderProgram);
+  CameraBlock cameraBlock;
+  cameraBlock.attach(shaderProgram);
+
+  JobScheduler scheduler(options.threads);
+  JobGraph frameGraph;
+  if (simulation) {
+    simulation->buildFrameGraph(frameGraph);
+    // set before any thread runs the jobs, they read it unsynchronised
+    simulation->setStageTiming(options.benchFrames > 0);
+  }
+  std::cout << "star update: " << simdIsaName(options.isa) << " on "
+            << scheduler.size() << " threads, seed " << options.seed
+            << std::endl;
+
+  FixedTimestep timestep(options.simHz);
+  float tickDistance = STAR_SPEED * timestep.seconds();
   float dist = 0;
-  std::cout << "zFar=" << zFar + 10.0f << std::endl;
-  while (!glfwWindowShouldClose(window)) {
-    int width, height;
+  bool uploaded = false;
+
+  // with its own thread the simulation never waits on the render loop, the
+  // render loop uploads whichever snapshot is newest when it gets to it
+  std::unique_ptr<SimulationThread> simulationThread;
+  if (options.simulationThread && simulation && !options.stateless) {
+    simulationThread = std::make_unique<SimulationThread>(
+        *simulation, scheduler, options.simHz);
+    std::cout << "simulation runs on its own thread" << std::endl;
+  }
+  std::unique_ptr<UploadThread> uploadThread;
+  if (threadedUpload) {
+    uploadThread = std::make_unique<UploadThread>(window, *simulationThread);
+    std::cout << "instances uploaded on their own thread" << std::endl;
+  }
 
-    float currentFrame = glfwGetTime();
+  std::unique_ptr<StarBudget> budget;
+  std::unique_ptr<GpuTimer> drawTimer;
+  if (options.targetMs > 0.0f) {
+    // stateless stars have no state to resize, only the draw count changes
+    bool resizable = options.stateless || (simulation && !simulationThread &&
+                                           simulation->resizable());
+    if (!resizable) {
+      std::cout << "adaptive star count needs stateless stars or the "
+                   "in-frame cpu simulation without a depth ring, keeping "
+                << starCount << " stars" << std::endl;
+    } else {
+      budget = std::make_unique<StarBudget>(
+          options.targetMs, std::min<size_t>(1000, starCount),
+          options.maxStars);
+      drawTimer = std::make_unique<GpuTimer>();
+    }
+  }
+
+  // a benchmark steps one tick per frame whatever the frame took, so every
+  // run does the same work, and only reports frames after a warm up
+  std::unique_ptr<BenchRecorder> bench;
+  int frameLimit = options.frames;
+  if (options.benchFrames > 0) {
+    bench = std::make_unique<BenchRecorder>();
+    frameLimit = BenchRecorder::WARMUP + options.benchFrames;
+    if (!drawTimer)
+      drawTimer = std::make_unique<GpuTimer>();
+    std::cout << "benchmark: " << options.benchFrames << " frames after "
+              << BenchRecorder::WARMUP << " warm up" << std::endl;
+  }
+  auto sinceMs = [](std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<float, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  };
+  // glfw's clock needs glfw, the headless mode has none
+  const double startSeconds = steadySeconds();
+  uint64_t countedCalls = glCalls();
+  uint64_t countedFrames = 0;
+  float countStart = 0.0f;
+  int frame = 0;
+  std::cout << "zFar=" << zFar + 10.0f << std::endl;
+  while (window == nullptr || !glfwWindowShouldClose(window)) {
+    if (frameLimit > 0 && frame == frameLimit)
+      break;
+    STARFIELD_TRACE("frame");
+    frame++;
+    auto frameStart = std::chrono::steady_clock::now();
+    bool measured = bench && frame > BenchRecorder::WARMUP;
+
+    // kept as a double for the stateless clock, a float second is only
+    // good to milliseconds after a day
+    double seconds = steadySeconds() - startSeconds;
+    if (bench)
+      seconds = frame * (double)timestep.seconds();
+    float currentFrame = seconds;
     deltaTime = currentFrame - lastFrame;
     lastFrame = currentFrame;
 
-    processInput(window);
+    // stars are drawn where they were at the last tick plus alpha of the next
+    // one. that's the same as shifting the current state back by what is
+    // left of the tick, all stars move alike so it's one model transform.
+    int ticks{0};
+    bool fresh{false};
+    float simulateMs{0.0f};
+    if (options.stateless) {
+      dist = 0;
+    } else if (simulationThread) {
+      STARFIELD_TRACE("take snapshot");
+      double snapshotTime;
+      if (uploadThread) {
+        fresh = uploadThread->acquire();
+        snapshotTime = uploadThread->time();
+      } else {
+        fresh = simulationThread->update();
+        snapshotTime = simulationThread->latest().time;
+      }
+      float alpha = (steadySeconds() - snapshotTime) / timestep.seconds();
+      dist = -(1.0f - std::clamp(alpha, 0.0f, 1.0f)) * tickDistance;
+    } else {
+      ticks = timestep.advance(bench ? timestep.seconds() : deltaTime);
+      dist = -(1.0f - timestep.alpha()) * tickDistance;
+    }
+
+    if (window) {
+      STARFIELD_TRACE("input");
+      processInput(window);
+    }
+
+    glm::mat4 starModel = glm::mat4(1.0f);
+    starModel = glm::translate(starModel, glm::vec3(0, 0, dist));
+
+    // the simulation and cull passes bind their own programs and vertex
+    // arrays, so they go before the draw state is set up
+    if (gpuSimulation) {
+      STARFIELD_TRACE("simulate");
+      auto updateStart = std::chrono::steady_clock::now();
+      gpuSimulation->advance(ticks, tickDistance);
+      if (culler) {
+        culler->cull(gpuSimulation->storageBuffer(), starCount,
+                     projection * cameraView() * starModel, options.draw);
+      }
+      glState.invalidate();
+      if (measured)
+        bench->add(BenchRecorder::Update, sinceMs(updateStart));
+    }
 
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
             GL_STENCIL_BUFFER_BIT); // also clear the depth buffer now!  |
                                     // GL_DEPTH_BUFFER_BIT
     // 2. use our shader program when we want to render an object
-    glUseProgram(shaderProgram);
+    glState.useProgram(shaderProgram);
 
-    glfwGetWindowSize(window, &width, &height);
-    glm::vec2 u_res(width, height);
-    int resolution = glGetUniformLocation(shaderProgram, "u_resolution");
-    glUniformMatrix4fv(resolution, 1, GL_FALSE, glm::value_ptr(u_res));
+    if (framebufferResized) {
+      glUniform2f(uniforms["u_resolution"], (float)framebufferWidth,
+                  (float)framebufferHeight);
+      setDrawModeUniforms(shaderProgram, projection[1][1], framebufferHeight);
+      framebufferResized = false;
+    }
+    cameraBlock.update(cameraView(), projection);
 
-    int modelprj = glGetUniformLocation(shaderProgram, "projection");
-    glUniformMatrix4fv(modelprj, 1, GL_FALSE, glm::value_ptr(projection));
+    glState.bindVertexArray(VAO);
 
-    camera(shaderProgram, (float)dist);
+    glUniformMatrix4fv(uniforms["model"], 1, GL_FALSE,
+                       glm::value_ptr(starModel));
 
-    glBindVertexArray(VAO);
-
-    glm::mat4 starModel = glm::mat4(1.0f);
-    starModel = glm::translate(starModel, glm::vec3(0, 0, dist));
-
-    int modelLoc = glGetUniformLocation(shaderProgram, "model");
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(starModel));
-
-    size_t index{0};
-    for (auto &vec : starOffsets) {
-      vec.z += 1;
+    if (options.stateless) {
+      setStatelessClock(uniforms, statelessClock(seconds));
+      uploaded = true;
+    } else if (uploadThread) {
+      // already uploaded, only the buffer to draw from changes
+      if (fresh) {
+        glBindBuffer(GL_ARRAY_BUFFER, uploadThread->buffer());
+        setupInstanceAttributes(simulation->format());
+      }
+      uploaded = uploadThread->buffer() != 0;
+    } else if (simulationThread) {
+      if (fresh) {
+        STARFIELD_TRACE("upload");
+        const auto &snapshot = simulationThread->latest().instances;
+        void *target = instances->begin(snapshot.size());
+        if (target != nullptr)
+          std::memcpy(target, snapshot.data(), snapshot.size());
+        instances->end(snapshot.size(), snapshot.data());
+        uploaded = true;
+      }
+    } else if (culler) {
+      culler->bindForDraw();
+      uploaded = true;
+    } else if (gpuSimulation) {
+      gpuSimulation->bindForDraw();
+      uploaded = true;
+    } else if (ticks > 0 || !uploaded) {
+      // no tick this frame means the instance buffer is still current. the
+      // copy jobs write straight into the mapped buffer, if mapping fails
+      // fall back to uploading the built instances in one go
+      auto simulateStart = std::chrono::steady_clock::now();
+      size_t instanceBytes = starCount * simulation->stride();
+      simulation->setUploadTarget(instances->begin(instanceBytes));
+      uploaded = true;
+      simulation->setTicks(ticks, tickDistance);
+
+      {
+        // the jobs trace their update and build on whichever thread ran them
+        STARFIELD_TRACE("simulate");
+        scheduler.run(frameGraph);
+      }
 
-      if (vec.z > zFar + 10.0f) {
-        vec.z = (float)zrand(e1);
+      auto uploadStart = std::chrono::steady_clock::now();
+      {
+        STARFIELD_TRACE("upload");
+        instances->end(instanceBytes, simulation->instances());
+        if (staticInstances) {
+          const StarField &stars = simulation->stars();
+          simulation->forEachRespawned([&](uint32_t index) {
+            staticInstances->set(index, stars.x()[index], stars.y()[index]);
+          });
+          staticInstances->flush();
+        }
+      }
+      simulateMs = sinceMs(simulateStart);
+      if (measured) {
+        // the copy jobs are the upload when they write to a mapped buffer
+        StageTimes stages = simulation->takeStageTimes();
+        bench->add(BenchRecorder::Update, stages.updateMs);
+        bench->add(BenchRecorder::Build, stages.buildMs);
+        bench->add(BenchRecorder::Upload,
+                   stages.copyMs + sinceMs(uploadStart));
       }
+    }
 
-      glm::mat4 model = glm::mat4(1.0f);
-      model = glm::translate(model, glm::vec3(vec.x, vec.y, vec.z));
-      if (vec.z > zFar / 2.0f) {
-        model = glm::scale(model, glm::vec3(0.1, 0.1, 1.0));
+    if (drawTimer)
+      drawTimer->begin();
+    if (uploaded) {
+      STARFIELD_TRACE("draw");
+      uint32_t baseInstance =
+          options.stateless || !instances
+              ? 0
+              : instances->baseInstance(simulation->stride());
+      if (staticInstances) {
+        // a base instance would shift the static stream as well, move only
+        // the z attribute to the current region instead
+        glBindBuffer(GL_ARRAY_BUFFER, instances->buffer());
+        setupInstanceAttributes(InstanceFormat::Split, instances->offset());
+        baseInstance = 0;
       }
-      offsetMatrices[index] = model;
-      /*     if (index == 0) {
-             std::cout << "mat4" << glm::to_string(model) << std::endl;
-             std::cout << "x:" << starOffsets[0].x << " y:" << starOffsets[0].y
-                       << " z:" << starOffsets[0].z << std::endl;
-           }
-      */
-      index++;
+      if (culler)
+        culler->draw(options.draw);
+      else
+        drawStars(options.draw, starCount, baseInstance);
+      if (uploadThread)
+        uploadThread->fence();
+      else if (instances)
+        instances->fence();
     }
-    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-    glBufferData(GL_ARRAY_BUFFER, offsetMatrices.size() * sizeof(glm::mat4),
-                 nullptr,
-                 GL_DYNAMIC_DRAW); // realloc in place same buffer
-                                   // with orphaning.. opengl magic.
-
-    glBufferSubData(GL_ARRAY_BUFFER, 0,
-                    offsetMatrices.size() * sizeof(glm::mat4),
-                    offsetMatrices.data());
-
-    glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, starOffsets.size(),
-                                      0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-    glfwSwapBuffers(window);
-    //  Keep running
-    glfwPollEvents();
+    if (drawTimer)
+      drawTimer->end();
+
+    if (budget) {
+      size_t wanted =
+          budget->update(starCount, simulateMs, drawTimer->lastMs());
+      if (wanted != starCount) {
+        starCount = wanted;
+        std::cout << "stars: " << starCount << std::endl;
+        // stateless stars are drawn by count, there is nothing else to resize
+        if (simulation) {
+          simulation->resize(starCount);
+          frameGraph.clear();
+          simulation->buildFrameGraph(frameGraph);
+          uploaded = false;
+          if (starCount > instanceCapacity) {
+            instanceCapacity = std::max(starCount, instanceCapacity * 2);
+            instances->resize(instanceCapacity * simulation->stride());
+            glState.bindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, instances->buffer());
+            setupInstanceAttributes(simulation->format());
+          }
+          // added stars never went through a respawn, upload them next
+          // frame along with that frame's patches
+          if (staticInstances) {
+            staticInstances->resize(starCount, simulation->stars().x(),
+                                    simulation->stars().y());
+          }
+        }
+      }
+    }
+    if (options.countGlCalls) {
+      countedFrames++;
+      if (currentFrame - countStart >= 1.0f) {
+        uint64_t calls = glCalls();
+        std::cout << "gl calls per frame: "
+                  << (calls - countedCalls) / countedFrames << std::endl;
+        countedCalls = calls;
+        countedFrames = 0;
+        countStart = currentFrame;
+      }
+    }
+    if (options.ppm != nullptr && frame == frameLimit) {
+      if (!writeFramebufferPpm(options.ppm, framebufferWidth,
+                               framebufferHeight))
+        std::cerr << "Error could not write " << options.ppm << std::endl;
+    }
+    presentFrame(window, headless.get());
+    if (traceRequested())
+      saveTrace(options.trace);
+    if (bench && drawTimer) {
+      drawTimer->drain([&](float ms) {
+        if (measured)
+          bench->add(BenchRecorder::Draw, ms);
+      });
+    }
+    if (measured)
+      bench->add(BenchRecorder::Frame, sinceMs(frameStart));
   }
 
+  if (bench) {
+    bench->writeJson(
+        std::cout,
+        {{"stars", std::to_string(starCount)},
+         {"sim", simBackendName(backend)},
+         {"isa", simdIsaName(options.isa)},
+         {"threads", std::to_string(scheduler.size())},
+         {"format", instanceFormatName(options.instanceFormat)},
+         {"upload", instances ? uploadModeName(instances->mode()) : "none"},
+         {"draw", drawModeName(options.draw)},
+         {"stateless", options.stateless ? "yes" : "no"},
+         {"sim_thread", simulationThread ? "yes" : "no"},
+         {"size", std::to_string(options.width) + "x" +
+                      std::to_string(options.height)},
+         {"headless", headless ? "yes" : "no"},
+         {"seed", std::to_string(options.seed)},
+         {"renderer", (const char *)glGetString(GL_RENDERER)},
+         {"gl", (const char *)glGetString(GL_VERSION)}});
+  }
+
+  if (tracingEnabled())
+    saveTrace(options.trace);
+
+  // everything holding GL objects goes while the context is still there
+  drawTimer.reset();
+  uploadThread.reset();
+  instances.reset();
+  staticInstances.reset();
+  culler.reset();
+  gpuSimulation.reset();
   glDeleteVertexArrays(1, &VAO);
   glDeleteBuffers(1, &VBO);
 
-  glfwDestroyWindow(window);
-  glfwTerminate();
+  closeWindow(window, headless);
   return 0;
 }
 
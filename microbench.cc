@@ -0,0 +1,202 @@
+// Microbenchmarks for the CPU star kernels, no window or GL involved.
+//   starbench [--max-stars N] [--threads N]
+// Every kernel runs at 1k to --max-stars (default 50M) stars, repeated
+// until it has taken long enough to time, and reports its best repetition.
+#include "advance.hh"
+#include "config.hh"
+#include "instance.hh"
+#include "jobs.hh"
+#include "rng.hh"
+#include "simulation.hh"
+#include "starfield.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <thread>
+#include <vector>
+
+constexpr double MIN_SECONDS = 0.25;
+constexpr int MIN_REPEATS = 3;
+constexpr uint32_t SEED = 1;
+// matrices are built into a buffer this big and overwritten, at 50M stars
+// the whole set would not fit in memory
+constexpr size_t MATRIX_BATCH = 65536;
+
+static volatile float sink;
+
+// Runs body until MIN_SECONDS and MIN_REPEATS are both reached, returns the
+// fastest run in seconds. reset runs untimed before every run, for bodies
+// that change their own input and would otherwise time different work.
+template <typename Body, typename Reset>
+static double timeBest(Body body, Reset reset) {
+  using clock = std::chrono::steady_clock;
+  double best = 1.0e30;
+  double total = 0.0;
+  for (int repeat = 0; repeat < MIN_REPEATS || total < MIN_SECONDS;
+       ++repeat) {
+    reset();
+    auto start = clock::now();
+    body();
+    double seconds =
+        std::chrono::duration<double>(clock::now() - start).count();
+    best = std::min(best, seconds);
+    total += seconds;
+  }
+  return best;
+}
+
+template <typename Body> static double timeBest(Body body) {
+  return timeBest(body, [] {});
+}
+
+static void report(const char *kernel, const char *variant, size_t stars,
+                   double seconds) {
+  std::printf("%-10s %-10s %10zu %10.3f ms %8.3f ns/star %9.1f Mstars/s\n",
+              kernel, variant, stars, seconds * 1.0e3, seconds * 1.0e9 / stars,
+              stars / seconds / 1.0e6);
+  std::fflush(stdout);
+}
+
+static void benchAdvance(size_t stars) {
+  StarField field = generateStarOffsets((uint32_t)stars, SEED);
+  // every run starts from here, so each respawns the same stars
+  const std::vector<float> z(field.z(), field.z() + stars);
+  const std::vector<uint32_t> generation(field.generation(),
+                                         field.generation() + stars);
+  std::vector<uint32_t> respawned(stars);
+  Respawn respawn = starRespawn(SEED);
+  for (SimdIsa isa :
+       {SimdIsa::Scalar, SimdIsa::Sse42, SimdIsa::Avx2, SimdIsa::Avx512}) {
+    if (isa > detectSimdIsa())
+      break;
+    AdvanceKernel advance = selectAdvanceKernel(isa);
+    double seconds = timeBest(
+        [&] {
+          advance(field.z(), field.generation(), 0, stars, STAR_SPEED / 30.0f,
+                  respawnLimit(), respawn, respawned.data());
+        },
+        [&] {
+          std::copy(z.begin(), z.end(), field.z());
+          std::copy(generation.begin(), generation.end(), field.generation());
+        });
+    report("advance", simdIsaName(isa), stars, seconds);
+  }
+}
+
+static void benchFrame(size_t stars, JobScheduler &scheduler) {
+  StarSimulation simulation((uint32_t)stars, detectSimdIsa(), SEED,
+                            InstanceFormat::Compact);
+  std::vector<unsigned char> upload(stars * simulation.stride());
+  simulation.setUploadTarget(upload.data());
+  simulation.setTicks(1, STAR_SPEED / 30.0f);
+  JobGraph graph;
+  simulation.buildFrameGraph(graph);
+  // every run starts from the same stars, so each respawns the same ones
+  StarField &field = simulation.stars();
+  const std::vector<float> x(field.x(), field.x() + stars);
+  const std::vector<float> y(field.y(), field.y() + stars);
+  const std::vector<float> z(field.z(), field.z() + stars);
+  const std::vector<uint32_t> generation(field.generation(),
+                                         field.generation() + stars);
+  double seconds = timeBest(
+      [&] { scheduler.run(graph); },
+      [&] {
+        std::copy(x.begin(), x.end(), field.x());
+        std::copy(y.begin(), y.end(), field.y());
+        std::copy(z.begin(), z.end(), field.z());
+        std::copy(generation.begin(), generation.end(), field.generation());
+      });
+  char threads[16];
+  std::snprintf(threads, sizeof(threads), "%zu threads", scheduler.size());
+  report("frame", threads, stars, seconds);
+}
+
+static void benchPack(size_t stars) {
+  StarField field = generateStarOffsets((uint32_t)stars, SEED);
+  for (InstanceFormat format : {InstanceFormat::Compact,
+                                InstanceFormat::Packed16,
+                                InstanceFormat::Split}) {
+    std::vector<unsigned char> out(stars * instanceStride(format));
+    double seconds = timeBest([&] {
+      packInstances(format, field.x(), field.y(), field.z(), 0, stars,
+                    out.data());
+    });
+    report("pack", instanceFormatName(format), stars, seconds);
+  }
+}
+
+// the per star translate and scale the instances replaced, for comparison
+static void benchMatrices(size_t stars) {
+  StarField field = generateStarOffsets((uint32_t)stars, SEED);
+  std::vector<glm::mat4> matrices(std::min(stars, MATRIX_BATCH));
+  double seconds = timeBest([&] {
+    for (size_t index = 0; index < stars; ++index) {
+      float scale = starScale(field.z()[index]);
+      glm::mat4 model = glm::translate(
+          glm::mat4(1.0f),
+          glm::vec3(field.x()[index], field.y()[index], field.z()[index]));
+      matrices[index % MATRIX_BATCH] =
+          glm::scale(model, glm::vec3(scale, scale, 1.0f));
+    }
+  });
+  sink = matrices[0][3][2];
+  report("matrices", "glm", stars, seconds);
+}
+
+static void benchGenerate(size_t stars) {
+  double seconds = timeBest([&] {
+    StarField field = generateStarOffsets((uint32_t)stars, SEED);
+    sink = field.z()[stars - 1];
+  });
+  report("generate", "offsets", stars, seconds);
+}
+
+static void benchRandom(size_t stars) {
+  uint32_t key = streamKey(SEED, STREAM_Z);
+  std::vector<float> out(stars);
+  double scalar = timeBest([&] {
+    for (size_t index = 0; index < stars; ++index)
+      out[index] = counterUniform(key, (uint32_t)index, 0, 0.0f, 1.0f);
+  });
+  report("rng", "scalar", stars, scalar);
+  double batch = timeBest([&] {
+    counterUniformBatch(key, 0, nullptr, 0.0f, 1.0f, out.data(), stars);
+  });
+  report("rng", "batch", stars, batch);
+  sink = out[stars - 1];
+}
+
+int main(int argc, char **argv) {
+  size_t maxStars = 50000000;
+  unsigned threads = std::thread::hardware_concurrency();
+  for (int index = 1; index < argc; ++index) {
+    if (std::strcmp(argv[index], "--max-stars") == 0 && index + 1 < argc) {
+      maxStars = std::strtoull(argv[++index], nullptr, 0);
+    } else if (std::strcmp(argv[index], "--threads") == 0 &&
+               index + 1 < argc) {
+      threads = std::atoi(argv[++index]);
+    } else {
+      std::fprintf(stderr, "usage: %s [--max-stars N] [--threads N]\n",
+                   argv[0]);
+      return 1;
+    }
+  }
+
+  JobScheduler scheduler(threads);
+  std::printf("%-10s %-10s %10s\n", "kernel", "variant", "stars");
+  for (size_t stars : {1000, 10000, 100000, 1000000, 10000000, 50000000}) {
+    if (stars > maxStars)
+      break;
+    benchAdvance(stars);
+    benchFrame(stars, scheduler);
+    benchPack(stars);
+    benchMatrices(stars);
+    benchGenerate(stars);
+    benchRandom(stars);
+  }
+  return 0;
+}
@@ -0,0 +1,232 @@
+#include "options.hh"
+#include "trace.hh"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// seed of --bench runs that do not pick one
+constexpr uint32_t BENCH_SEED = 1;
+
+static void usage(const char *program) {
+  std::cerr << "usage: " << program << " [options]\n"
+            << "  --isa scalar|sse4.2|avx2|avx512  star update kernel "
+               "(default: widest supported)\n"
+            << "  --threads N                      threads running the frame "
+               "jobs (default: all cores)\n"
+            << "  --sim-hz N                       simulation ticks per "
+               "second (default: 30)\n"
+            << "  --sim-thread                     simulate on a separate "
+               "thread from rendering\n"
+            << "  --upload-thread                  upload instances on a "
+               "shared context thread (implies --sim-thread)\n"
+            << "  --sim cpu|compute|feedback       where stars are simulated "
+               "(default: cpu)\n"
+            << "  --verify-gpu N                   compare N frames of cpu "
+               "and gpu simulation, then exit\n"
+            << "  --seed N                         star placement seed "
+               "(default: random)\n"
+            << "  --stateless                      compute star positions "
+               "from time in the shader\n"
+            << "  --depth-ring                     keep stars sorted by depth, "
+               "recycle only the far end\n"
+            << "  --instance-format compact|packed16|split  per star "
+               "upload layout (default: compact)\n"
+            << "  --upload orphan|persistent       instance upload path "
+               "(default: persistent)\n"
+            << "  --draw quads|points|strip        star geometry (default: "
+               "quads)\n"
+            << "  --cull                           frustum cull on the gpu "
+               "and draw indirect (needs --sim compute)\n"
+            << "  --draw-bench N                   time N frames of every "
+               "draw mode, then exit\n"
+            << "  --headless                       render offscreen through "
+               "surfaceless EGL, no window\n"
+            << "  --size WxH                       window or offscreen size "
+               "(default: 1600x1100)\n"
+            << "  --frames N                       exit after N frames\n"
+            << "  --bench N                        time N frames without "
+               "vsync, print json and exit\n"
+            << "  --ppm FILE                       write the last of --frames "
+               "to FILE\n"
+            << "  --trace FILE                     write the trace to FILE on "
+               "exit or SIGUSR1 (default: starfield-trace.json)\n"
+            << "  --gl-calls                       print the gl calls "
+               "made per frame every second\n"
+            << "  --stars N                        number of stars (default: "
+               "100000)\n"
+            << "  --target-ms X                    adapt the star count to "
+               "X ms of simulation and draw time\n"
+            << "  --max-stars N                    upper limit for the "
+               "adaptive star count (default: 8000000)\n";
+  exit(1);
+}
+
+static const char *value(int argc, char **argv, int &index) {
+  if (index + 1 >= argc) {
+    std::cerr << "Error missing value for " << argv[index] << std::endl;
+    usage(argv[0]);
+  }
+  return argv[++index];
+}
+
+Options parseOptions(int argc, char **argv) {
+  Options options;
+  bool seeded = false;
+
+  for (int index = 1; index < argc; ++index) {
+    const char *arg = argv[index];
+    if (std::strcmp(arg, "--isa") == 0) {
+      SimdIsa isa;
+      if (!parseSimdIsa(value(argc, argv, index), isa)) {
+        std::cerr << "Error unknown isa " << argv[index] << std::endl;
+        usage(argv[0]);
+      }
+      if (isa > detectSimdIsa()) {
+        std::cerr << "Error " << simdIsaName(isa)
+                  << " is not supported on this cpu" << std::endl;
+        exit(1);
+      }
+      options.isa = isa;
+    } else if (std::strcmp(arg, "--threads") == 0) {
+      int threads = std::atoi(value(argc, argv, index));
+      if (threads < 1) {
+        std::cerr << "Error need at least one thread" << std::endl;
+        usage(argv[0]);
+      }
+      options.threads = threads;
+    } else if (std::strcmp(arg, "--sim-hz") == 0) {
+      float hz = std::atof(value(argc, argv, index));
+      if (hz <= 0.0f) {
+        std::cerr << "Error simulation rate has to be positive" << std::endl;
+        usage(argv[0]);
+      }
+      options.simHz = hz;
+    } else if (std::strcmp(arg, "--sim-thread") == 0) {
+      options.simulationThread = true;
+    } else if (std::strcmp(arg, "--upload-thread") == 0) {
+      options.uploadThread = true;
+      options.simulationThread = true;
+    } else if (std::strcmp(arg, "--sim") == 0) {
+      if (!parseSimBackend(value(argc, argv, index), options.backend)) {
+        std::cerr << "Error unknown simulation " << argv[index] << std::endl;
+        usage(argv[0]);
+      }
+    } else if (std::strcmp(arg, "--verify-gpu") == 0) {
+      options.verifyGpuFrames = std::atoi(value(argc, argv, index));
+      if (options.verifyGpuFrames < 1) {
+        std::cerr << "Error need at least one frame to verify" << std::endl;
+        usage(argv[0]);
+      }
+    } else if (std::strcmp(arg, "--stateless") == 0) {
+      options.stateless = true;
+    } else if (std::strcmp(arg, "--depth-ring") == 0) {
+      options.depthRing = true;
+    } else if (std::strcmp(arg, "--instance-format") == 0) {
+      if (!parseInstanceFormat(value(argc, argv, index),
+                               options.instanceFormat)) {
+        std::cerr << "Error unknown instance format " << argv[index]
+                  << std::endl;
+        usage(argv[0]);
+      }
+    } else if (std::strcmp(arg, "--upload") == 0) {
+      if (!parseUploadMode(value(argc, argv, index), options.upload)) {
+        std::cerr << "Error unknown upload mode " << argv[index] << std::endl;
+        usage(argv[0]);
+      }
+    } else if (std::strcmp(arg, "--draw") == 0) {
+      if (!parseDrawMode(value(argc, argv, index), options.draw)) {
+        std::cerr << "Error unknown draw mode " << argv[index] << std::endl;
+        usage(argv[0]);
+      }
+    } else if (std::strcmp(arg, "--cull") == 0) {
+      options.cull = true;
+    } else if (std::strcmp(arg, "--draw-bench") == 0) {
+      options.drawBenchFrames = std::atoi(value(argc, argv, index));
+      if (options.drawBenchFrames < 1) {
+        std::cerr << "Error need at least one frame to benchmark" << std::endl;
+        usage(argv[0]);
+      }
+    } else if (std::strcmp(arg, "--headless") == 0) {
+      options.headless = true;
+    } else if (std::strcmp(arg, "--size") == 0) {
+      if (std::sscanf(value(argc, argv, index), "%dx%d", &options.width,
+                      &options.height) != 2 ||
+          options.width < 1 || options.height < 1) {
+        std::cerr << "Error size has to be WIDTHxHEIGHT" << std::endl;
+        usage(argv[0]);
+      }
+    } else if (std::strcmp(arg, "--frames") == 0) {
+      options.frames = std::atoi(value(argc, argv, index));
+      if (options.frames < 1) {
+        std::cerr << "Error need at least one frame" << std::endl;
+        usage(argv[0]);
+      }
+    } else if (std::strcmp(arg, "--bench") == 0) {
+      options.benchFrames = std::atoi(value(argc, argv, index));
+      if (options.benchFrames < 1) {
+        std::cerr << "Error need at least one frame to benchmark" << std::endl;
+        usage(argv[0]);
+      }
+    } else if (std::strcmp(arg, "--ppm") == 0) {
+      options.ppm = value(argc, argv, index);
+    } else if (std::strcmp(arg, "--trace") == 0) {
+      options.trace = value(argc, argv, index);
+      if (!tracingEnabled()) {
+        std::cerr << "Error tracing needs a build with STARFIELD_TRACING"
+                  << std::endl;
+        usage(argv[0]);
+      }
+    } else if (std::strcmp(arg, "--gl-calls") == 0) {
+      options.countGlCalls = true;
+    } else if (std::strcmp(arg, "--stars") == 0) {
+      options.stars = std::strtoul(value(argc, argv, index), nullptr, 0);
+    } else if (std::strcmp(arg, "--max-stars") == 0) {
+      options.maxStars = std::strtoul(value(argc, argv, index), nullptr, 0);
+    } else if (std::strcmp(arg, "--target-ms") == 0) {
+      options.targetMs = std::atof(value(argc, argv, index));
+      if (options.targetMs <= 0.0f) {
+        std::cerr << "Error frame budget has to be positive" << std::endl;
+        usage(argv[0]);
+      }
+    } else if (std::strcmp(arg, "--seed") == 0) {
+      options.seed = std::strtoul(value(argc, argv, index), nullptr, 0);
+      seeded = true;
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (options.instanceFormat == InstanceFormat::Split &&
+      (options.depthRing || options.simulationThread)) {
+    std::cerr << "Error split instances need the in-frame simulation "
+                 "without a depth ring"
+              << std::endl;
+    usage(argv[0]);
+  }
+  if (options.headless && options.uploadThread) {
+    std::cerr << "Error the upload thread needs a window to share with"
+              << std::endl;
+    usage(argv[0]);
+  }
+  // a simulation thread ticks in real time, so how much it simulates per
+  // frame would depend on how fast the frames are
+  if (options.benchFrames > 0 && options.simulationThread) {
+    std::cerr << "Error --bench steps the simulation once per frame, it "
+                 "cannot run on its own thread"
+              << std::endl;
+    usage(argv[0]);
+  }
+  // benchmarks compare runs, which only works on the same stars
+  if (options.benchFrames > 0 && !seeded)
+    options.seed = BENCH_SEED;
+  if (options.ppm != nullptr && options.frames == 0 &&
+      options.benchFrames == 0) {
+    std::cerr << "Error --ppm needs --frames" << std::endl;
+    usage(argv[0]);
+  }
+  if (options.stars < 1 || options.maxStars < options.stars) {
+    std::cerr << "Error need between 1 and --max-stars stars" << std::endl;
+    usage(argv[0]);
+  }
+  return options;
+}
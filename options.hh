@@ -0,0 +1,43 @@
+#pragma once
+#include "advance.hh"
+#include "config.hh"
+#include "drawmode.hh"
+#include "gpusim.hh"
+#include "instance.hh"
+#include "instancestream.hh"
+#include <cstdint>
+#include <random>
+#include <thread>
+
+struct Options {
+  SimdIsa isa{detectSimdIsa()};
+  unsigned threads{std::thread::hardware_concurrency()};
+  float simHz{30.0f};
+  SimBackend backend{SimBackend::Cpu};
+  int verifyGpuFrames{0}; // > 0 compares cpu and gpu simulation and exits
+  bool simulationThread{false};
+  bool uploadThread{false}; // implies simulationThread
+  bool stateless{false};
+  bool depthRing{false};
+  InstanceFormat instanceFormat{InstanceFormat::Compact};
+  UploadMode upload{UploadMode::Persistent};
+  DrawMode draw{DrawMode::Quads};
+  bool cull{false};
+  int drawBenchFrames{0}; // > 0 times every draw mode and exits
+  bool countGlCalls{false};
+  bool headless{false};
+  int width{SCREEN_WIDTH}; // window or offscreen framebuffer
+  int height{SCREEN_HEIGHT};
+  int frames{0}; // > 0 exits after that many frames
+  const char *ppm{nullptr}; // last frame goes here
+  // trace written on exit and SIGUSR1 by builds with STARFIELD_TRACING
+  const char *trace{"starfield-trace.json"};
+  int benchFrames{0}; // > 0 measures that many frames, prints JSON, exits
+  uint32_t stars{100000};
+  uint32_t maxStars{8000000};
+  float targetMs{0.0f}; // 0 keeps the star count fixed
+  uint32_t seed{std::random_device{}()};
+};
+
+// Exits with a usage message on anything it does not understand.
+Options parseOptions(int argc, char **argv);
@@ -0,0 +1,402 @@
+// Regression gate for starfield --bench runs:
+//   starfield --headless --bench 600 | perfgate [options]
+// reads the JSON line the benchmark prints last, compares its frame times
+// with the latest run of another commit on the same machine and settings,
+// and exits 1 if they got significantly slower. Passing runs are appended
+// to the history so they become the baseline of the next commit.
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct GateOptions {
+  std::string history{"perfgate.history"};
+  std::string commit;   // default: git rev-parse --short HEAD
+  std::string baseline; // default: the latest other commit in history
+  std::string metric{"frame"};
+  double threshold{0.05}; // slowdown of the median that fails the gate
+  double alpha{0.01};     // significance the slowdown needs
+  bool record{true};
+};
+
+static void usage(const char *program) {
+  std::cerr << "usage: starfield --bench N | " << program << " [options]\n"
+            << "  --history FILE    runs so far (default: perfgate.history)\n"
+            << "  --commit SHA      this run's commit (default: git HEAD)\n"
+            << "  --baseline SHA    compare with this commit (default: the "
+               "latest other one)\n"
+            << "  --metric NAME     frame|update|build|upload|draw (default: "
+               "frame)\n"
+            << "  --threshold PCT   median slowdown that fails (default: 5)\n"
+            << "  --alpha P         significance level (default: 0.01)\n"
+            << "  --no-record       only compare, leave the history alone\n";
+  exit(1);
+}
+
+static const char *value(int argc, char **argv, int &index) {
+  if (index + 1 >= argc)
+    usage(argv[0]);
+  return argv[++index];
+}
+
+static GateOptions parseGateOptions(int argc, char **argv) {
+  GateOptions options;
+  for (int index = 1; index < argc; ++index) {
+    const char *arg = argv[index];
+    if (std::strcmp(arg, "--history") == 0) {
+      options.history = value(argc, argv, index);
+    } else if (std::strcmp(arg, "--commit") == 0) {
+      options.commit = value(argc, argv, index);
+    } else if (std::strcmp(arg, "--baseline") == 0) {
+      options.baseline = value(argc, argv, index);
+    } else if (std::strcmp(arg, "--metric") == 0) {
+      options.metric = value(argc, argv, index);
+    } else if (std::strcmp(arg, "--threshold") == 0) {
+      options.threshold = std::atof(value(argc, argv, index)) / 100.0;
+    } else if (std::strcmp(arg, "--alpha") == 0) {
+      options.alpha = std::atof(value(argc, argv, index));
+      if (options.alpha <= 0.0 || options.alpha >= 1.0) {
+        std::cerr << "Error alpha must be between 0 and 1" << std::endl;
+        exit(1);
+      }
+    } else if (std::strcmp(arg, "--no-record") == 0) {
+      options.record = false;
+    } else {
+      usage(argv[0]);
+    }
+  }
+  return options;
+}
+
+// Just enough of a JSON reader for the benchmark's line: the settings'
+// strings and the sample arrays of numbers, everything else is skipped.
+class BenchLine {
+public:
+  explicit BenchLine(const std::string &text) : text(text) {}
+
+  void parse(std::vector<std::pair<std::string, std::string>> &settings,
+             std::map<std::string, std::vector<double>> &samples) {
+    expect('{');
+    while (!consume('}')) {
+      std::string key = string();
+      expect(':');
+      if (key == "settings") {
+        expect('{');
+        while (!consume('}')) {
+          std::string name = string();
+          expect(':');
+          settings.emplace_back(name, string());
+          consume(',');
+        }
+      } else if (key == "samples") {
+        expect('{');
+        while (!consume('}')) {
+          std::vector<double> &values = samples[string()];
+          expect(':');
+          expect('[');
+          while (!consume(']')) {
+            values.push_back(number());
+            consume(',');
+          }
+          consume(',');
+        }
+      } else {
+        skip();
+      }
+      consume(',');
+    }
+  }
+
+private:
+  const std::string &text;
+  size_t at{0};
+
+  [[noreturn]] void fail() {
+    std::cerr << "Error malformed benchmark json at column " << at
+              << std::endl;
+    exit(1);
+  }
+  bool consume(char c) {
+    while (at < text.size() && std::isspace((unsigned char)text[at]))
+      ++at;
+    if (at < text.size() && text[at] == c) {
+      ++at;
+      return true;
+    }
+    return false;
+  }
+  void expect(char c) {
+    if (!consume(c))
+      fail();
+  }
+  std::string string() {
+    expect('"');
+    std::string result;
+    while (at < text.size() && text[at] != '"') {
+      if (text[at] == '\\' && at + 1 < text.size())
+        ++at;
+      result += text[at++];
+    }
+    expect('"');
+    return result;
+  }
+  double number() {
+    while (at < text.size() && std::isspace((unsigned char)text[at]))
+      ++at;
+    const char *start = text.c_str() + at;
+    char *end = nullptr;
+    double result = std::strtod(start, &end);
+    if (end == start)
+      fail();
+    at += end - start;
+    return result;
+  }
+  void skip() {
+    if (consume('{') || consume('[')) {
+      int depth = 1;
+      while (depth > 0 && at < text.size()) {
+        if (text[at] == '"') {
+          string();
+          continue;
+        }
+        char c = text[at++];
+        depth += (c == '{' || c == '[') - (c == '}' || c == ']');
+      }
+    } else if (at < text.size() && text[at] == '"') {
+      string();
+    } else {
+      number();
+    }
+  }
+};
+
+// FNV-1a, as hex for the history file
+static std::string fingerprint(const std::string &text) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : text) {
+    hash ^= (unsigned char)c;
+    hash *= 1099511628211ull;
+  }
+  char hex[17];
+  std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+  return hex;
+}
+
+// cpu model, core count and host name; the gpu is part of the settings
+static std::string machineFingerprint() {
+  std::string description;
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.rfind("model name", 0) == 0) {
+      description = line;
+      break;
+    }
+  }
+  description += ' ' + std::to_string(std::thread::hardware_concurrency());
+  char host[256] = {};
+  gethostname(host, sizeof(host) - 1);
+  return fingerprint(description + ' ' + host);
+}
+
+static std::string gitHead() {
+  std::string head;
+  if (FILE *git = popen("git rev-parse --short HEAD 2>/dev/null", "r")) {
+    char line[64];
+    if (std::fgets(line, sizeof(line), git))
+      head = line;
+    pclose(git);
+  }
+  while (!head.empty() && std::isspace((unsigned char)head.back()))
+    head.pop_back();
+  return head;
+}
+
+// One line of the history file:
+//   commit machine settings metric count sample...
+struct Run {
+  std::string commit, machine, settings, metric;
+  std::vector<double> samples;
+};
+
+static std::vector<Run> readHistory(const std::string &path) {
+  std::vector<Run> runs;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    Run run;
+    size_t count = 0;
+    if (!(fields >> run.commit >> run.machine >> run.settings >> run.metric >>
+          count))
+      continue;
+    run.samples.resize(count);
+    for (double &sample : run.samples)
+      fields >> sample;
+    if (fields)
+      runs.push_back(std::move(run));
+  }
+  return runs;
+}
+
+static void appendHistory(const std::string &path, const Run &run) {
+  std::ofstream out(path, std::ios::app);
+  out << run.commit << ' ' << run.machine << ' ' << run.settings << ' '
+      << run.metric << ' ' << run.samples.size();
+  for (double sample : run.samples)
+    out << ' ' << sample;
+  out << '\n';
+  if (!out) {
+    std::cerr << "Error could not append to " << path << std::endl;
+    exit(1);
+  }
+}
+
+static double median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  size_t half = values.size() / 2;
+  return values.size() % 2 ? values[half]
+                           : (values[half - 1] + values[half]) / 2.0;
+}
+
+// One sided Mann-Whitney U: the probability of samples at least this much
+// larger than baseline if both came from the same distribution. Normal
+// approximation with tie and continuity correction, fine for the hundreds
+// of frames a benchmark has.
+static double mannWhitneyGreater(const std::vector<double> &samples,
+                                 const std::vector<double> &baseline) {
+  struct Ranked {
+    double value;
+    bool sample;
+  };
+  std::vector<Ranked> all;
+  for (double value : samples)
+    all.push_back({value, true});
+  for (double value : baseline)
+    all.push_back({value, false});
+  std::sort(all.begin(), all.end(), [](const Ranked &a, const Ranked &b) {
+    return a.value < b.value;
+  });
+
+  double n1 = samples.size(), n2 = baseline.size(), n = all.size();
+  double rankSum = 0.0, ties = 0.0;
+  for (size_t first = 0; first < all.size();) {
+    size_t last = first;
+    while (last < all.size() && all[last].value == all[first].value)
+      ++last;
+    // ranks first + 1 .. last share their average
+    double rank = (first + 1 + last) / 2.0;
+    double tied = last - first;
+    for (size_t index = first; index < last; ++index)
+      rankSum += all[index].sample ? rank : 0.0;
+    ties += tied * tied * tied - tied;
+    first = last;
+  }
+
+  double u = rankSum - n1 * (n1 + 1.0) / 2.0;
+  double variance = n1 * n2 / 12.0 * ((n + 1.0) - ties / (n * (n - 1.0)));
+  if (variance <= 0.0)
+    return u > n1 * n2 / 2.0 ? 0.0 : 1.0;
+  double z = (u - n1 * n2 / 2.0 - 0.5) / std::sqrt(variance);
+  return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+int main(int argc, char **argv) {
+  GateOptions options = parseGateOptions(argc, argv);
+
+  // the benchmark logs before its json, which is the last line with an
+  // object on it
+  std::string line, json;
+  while (std::getline(std::cin, line)) {
+    if (!line.empty() && line[0] == '{')
+      json = line;
+  }
+  if (json.empty()) {
+    std::cerr << "Error no benchmark json on stdin, run starfield --bench N"
+              << std::endl;
+    exit(1);
+  }
+  std::vector<std::pair<std::string, std::string>> settings;
+  std::map<std::string, std::vector<double>> samples;
+  BenchLine(json).parse(settings, samples);
+
+  Run run;
+  run.commit = options.commit.empty() ? gitHead() : options.commit;
+  if (run.commit.empty())
+    run.commit = "unknown";
+  run.machine = machineFingerprint();
+  std::string described;
+  for (const auto &setting : settings)
+    described += setting.first + '=' + setting.second + ';';
+  run.settings = fingerprint(described);
+  run.metric = options.metric;
+  run.samples = samples[options.metric];
+  if (run.samples.size() < 2 ||
+      run.commit.find_first_of(" \t\n") != std::string::npos) {
+    std::cerr << "Error need a commit without spaces and at least two "
+              << options.metric << " samples" << std::endl;
+    exit(1);
+  }
+
+  // only runs that measured the same thing on the same machine compare
+  const Run *baseline = nullptr;
+  std::vector<Run> history = readHistory(options.history);
+  for (const Run &candidate : history) {
+    if (candidate.machine != run.machine ||
+        candidate.settings != run.settings || candidate.metric != run.metric)
+      continue;
+    if (options.baseline.empty() ? candidate.commit != run.commit
+                                 : candidate.commit == options.baseline)
+      baseline = &candidate;
+  }
+
+  bool regressed = false;
+  std::cout << "perfgate: " << run.metric << " of " << run.commit << ", "
+            << run.samples.size() << " samples, median " << median(run.samples)
+            << " ms" << std::endl;
+  // a baseline asked for by name that is not there is an error, a typo must
+  // not let everything pass
+  if (!baseline && !options.baseline.empty()) {
+    std::cerr << "Error no run of " << options.baseline << " in "
+              << options.history << " for this machine, settings and metric"
+              << std::endl;
+    exit(1);
+  }
+  if (!baseline) {
+    std::cout << "perfgate: no baseline for this machine and settings yet"
+              << std::endl;
+  } else {
+    double base = median(baseline->samples);
+    double current = median(run.samples);
+    // a zero or broken median would make the change inf or nan, and nan
+    // passes any threshold
+    if (!std::isfinite(base) || base <= 0.0 || !std::isfinite(current)) {
+      std::cerr << "Error cannot compare " << run.metric << " medians " << base
+                << " ms of " << baseline->commit << " and " << current
+                << " ms" << std::endl;
+      exit(1);
+    }
+    double change = current / base - 1.0;
+    double p = mannWhitneyGreater(run.samples, baseline->samples);
+    regressed = change > options.threshold && p < options.alpha;
+    std::printf("perfgate: against %s, median %g ms: %+.1f%%, p = %.3g, %s\n",
+                baseline->commit.c_str(), base, change * 100.0, p,
+                regressed ? "REGRESSION" : "ok");
+  }
+
+  // a regression must not become the next commit's baseline
+  if (options.record && !regressed)
+    appendHistory(options.history, run);
+  return regressed ? 1 : 0;
+}
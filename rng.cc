@@ -0,0 +1,97 @@
+#include "rng.hh"
+#include "advance.hh"
+#include "rnglanes.hh"
+
+using BatchKernel = void (*)(uint32_t key, uint32_t firstIndex,
+                             const uint32_t *generation, float lo, float range,
+                             float *out, size_t begin, size_t count);
+
+// Reference path, also used for the tail of the vector kernels.
+static void batchScalar(uint32_t key, uint32_t firstIndex,
+                        const uint32_t *generation, float lo, float range,
+                        float *out, size_t begin, size_t count) {
+  for (size_t index = begin; index < count; ++index) {
+    out[index] = counterUniform(key, firstIndex + (uint32_t)index,
+                                generation ? generation[index] : 0, lo, range);
+  }
+}
+
+#ifdef STARFIELD_X86
+__attribute__((target("sse4.2"))) static void
+batchSse42(uint32_t key, uint32_t firstIndex, const uint32_t *generation,
+           float lo, float range, float *out, size_t begin, size_t count) {
+  const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+  __m128i g = _mm_setzero_si128();
+  size_t index = begin;
+  for (; index + 4 <= count; index += 4) {
+    __m128i ids =
+        _mm_add_epi32(_mm_set1_epi32((int)(firstIndex + index)), lanes);
+    if (generation) {
+      g = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(generation + index));
+    }
+    _mm_storeu_ps(out + index, counterUniformSse(key, ids, g, lo, range));
+  }
+  batchScalar(key, firstIndex, generation, lo, range, out, index, count);
+}
+
+__attribute__((target("avx2"))) static void
+batchAvx2(uint32_t key, uint32_t firstIndex, const uint32_t *generation,
+          float lo, float range, float *out, size_t begin, size_t count) {
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i g = _mm256_setzero_si256();
+  size_t index = begin;
+  for (; index + 8 <= count; index += 8) {
+    __m256i ids =
+        _mm256_add_epi32(_mm256_set1_epi32((int)(firstIndex + index)), lanes);
+    if (generation) {
+      g = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(generation + index));
+    }
+    _mm256_storeu_ps(out + index, counterUniformAvx2(key, ids, g, lo, range));
+  }
+  batchScalar(key, firstIndex, generation, lo, range, out, index, count);
+}
+
+__attribute__((target("avx512f"))) static void
+batchAvx512(uint32_t key, uint32_t firstIndex, const uint32_t *generation,
+            float lo, float range, float *out, size_t begin, size_t count) {
+  const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                          11, 12, 13, 14, 15);
+  __m512i g = _mm512_setzero_si512();
+  size_t index = begin;
+  for (; index + 16 <= count; index += 16) {
+    __m512i ids =
+        _mm512_add_epi32(_mm512_set1_epi32((int)(firstIndex + index)), lanes);
+    if (generation)
+      g = _mm512_loadu_si512(generation + index);
+    _mm512_storeu_ps(out + index,
+                     counterUniformAvx512(key, ids, g, lo, range));
+  }
+  batchScalar(key, firstIndex, generation, lo, range, out, index, count);
+}
+#endif
+
+// the widest the CPU has, picked on first use
+static BatchKernel selectBatchKernel() {
+#ifdef STARFIELD_X86
+  switch (detectSimdIsa()) {
+  case SimdIsa::Avx512:
+    return batchAvx512;
+  case SimdIsa::Avx2:
+    return batchAvx2;
+  case SimdIsa::Sse42:
+    return batchSse42;
+  case SimdIsa::Scalar:
+    break;
+  }
+#endif
+  return batchScalar;
+}
+
+void counterUniformBatch(uint32_t key, uint32_t firstIndex,
+                         const uint32_t *generation, float lo, float range,
+                         float *out, size_t count) {
+  static const BatchKernel kernel = selectBatchKernel();
+  kernel(key, firstIndex, generation, lo, range, out, 0, count);
+}
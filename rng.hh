@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Counter-based random numbers. A draw is a pure hash of a key (seed and
+// stream), the star index and that star's generation (how often it has
+// respawned), so a star gets the same values whichever thread or vector
+// lane computes it and in whatever order. Only 32 bit multiply, xor and
+// shift are used so the vector kernels can compute it lane for lane.
+
+enum RandomStream : uint32_t { STREAM_X = 0, STREAM_Y = 1, STREAM_Z = 2 };
+
+constexpr uint32_t RNG_MIX1 = 0x7feb352du;
+constexpr uint32_t RNG_MIX2 = 0x846ca68bu;
+constexpr uint32_t RNG_GOLDEN = 0x9e3779b9u;
+constexpr float RNG_UNIT = 1.0f / 16777216.0f;
+
+// Bijective 32 bit integer finaliser.
+inline uint32_t mix32(uint32_t x) {
+  x ^= x >> 16;
+  x *= RNG_MIX1;
+  x ^= x >> 15;
+  x *= RNG_MIX2;
+  x ^= x >> 16;
+  return x;
+}
+
+inline uint32_t streamKey(uint32_t seed, uint32_t stream) {
+  return mix32(seed ^ mix32(stream + RNG_GOLDEN));
+}
+
+inline uint32_t counterRandom(uint32_t key, uint32_t index,
+                              uint32_t generation) {
+  return mix32(mix32(index + key) ^ (generation * RNG_GOLDEN));
+}
+
+// Uniform float in [lo, lo + range).
+inline float counterUniform(uint32_t key, uint32_t index, uint32_t generation,
+                            float lo, float range) {
+  return lo + (float)(counterRandom(key, index, generation) >> 8) * RNG_UNIT *
+                  range;
+}
+
+// Fills out[i] with counterUniform for star firstIndex + i, bit for bit, in
+// vector lanes of the widest instruction set the CPU has. generation may be
+// nullptr for stars that never respawned.
+void counterUniformBatch(uint32_t key, uint32_t firstIndex,
+                         const uint32_t *generation, float lo, float range,
+                         float *out, size_t count);
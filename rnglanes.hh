@@ -0,0 +1,75 @@
+#pragma once
+#include "rng.hh"
+
+// counterUniform from rng.hh, one lane per star, for the vector kernels.
+// Same operations in the same order as the scalar version, so every lane
+// rounds alike; build users with -ffp-contract=off.
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STARFIELD_X86 1
+
+__attribute__((target("sse4.2"))) static inline __m128i mix32Sse(__m128i x) {
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+  x = _mm_mullo_epi32(x, _mm_set1_epi32((int)RNG_MIX1));
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+  x = _mm_mullo_epi32(x, _mm_set1_epi32((int)RNG_MIX2));
+  return _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+}
+
+__attribute__((target("sse4.2"))) static inline __m128
+counterUniformSse(uint32_t key, __m128i index, __m128i generation, float lo,
+                  float range) {
+  __m128i bits = mix32Sse(_mm_add_epi32(index, _mm_set1_epi32((int)key)));
+  bits = mix32Sse(_mm_xor_si128(
+      bits, _mm_mullo_epi32(generation, _mm_set1_epi32((int)RNG_GOLDEN))));
+  __m128 unit = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(bits, 8)),
+                           _mm_set1_ps(RNG_UNIT));
+  return _mm_add_ps(_mm_set1_ps(lo), _mm_mul_ps(unit, _mm_set1_ps(range)));
+}
+
+__attribute__((target("avx2"))) static inline __m256i mix32Avx2(__m256i x) {
+  x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+  x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)RNG_MIX1));
+  x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+  x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)RNG_MIX2));
+  return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+}
+
+__attribute__((target("avx2"))) static inline __m256
+counterUniformAvx2(uint32_t key, __m256i index, __m256i generation, float lo,
+                   float range) {
+  __m256i bits =
+      mix32Avx2(_mm256_add_epi32(index, _mm256_set1_epi32((int)key)));
+  bits = mix32Avx2(_mm256_xor_si256(
+      bits,
+      _mm256_mullo_epi32(generation, _mm256_set1_epi32((int)RNG_GOLDEN))));
+  __m256 unit = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(bits, 8)),
+                              _mm256_set1_ps(RNG_UNIT));
+  return _mm256_add_ps(_mm256_set1_ps(lo),
+                       _mm256_mul_ps(unit, _mm256_set1_ps(range)));
+}
+
+__attribute__((target("avx512f"))) static inline __m512i
+mix32Avx512(__m512i x) {
+  x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 16));
+  x = _mm512_mullo_epi32(x, _mm512_set1_epi32((int)RNG_MIX1));
+  x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 15));
+  x = _mm512_mullo_epi32(x, _mm512_set1_epi32((int)RNG_MIX2));
+  return _mm512_xor_si512(x, _mm512_srli_epi32(x, 16));
+}
+
+__attribute__((target("avx512f"))) static inline __m512
+counterUniformAvx512(uint32_t key, __m512i index, __m512i generation,
+                     float lo, float range) {
+  __m512i bits =
+      mix32Avx512(_mm512_add_epi32(index, _mm512_set1_epi32((int)key)));
+  bits = mix32Avx512(_mm512_xor_si512(
+      bits,
+      _mm512_mullo_epi32(generation, _mm512_set1_epi32((int)RNG_GOLDEN))));
+  __m512 unit = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(bits, 8)),
+                              _mm512_set1_ps(RNG_UNIT));
+  return _mm512_add_ps(_mm512_set1_ps(lo),
+                       _mm512_mul_ps(unit, _mm512_set1_ps(range)));
+}
+#endif
@@ -0,0 +1,64 @@
+#include "simthread.hh"
+#include "config.hh"
+#include "trace.hh"
+#include <chrono>
+
+// ticks to catch up on at most before dropping simulated time
+constexpr int MAX_CATCH_UP = 8;
+
+double steadySeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+SimulationThread::SimulationThread(StarSimulation &simulation,
+                                   JobScheduler &scheduler, float hz)
+    : simulation(simulation), scheduler(scheduler), tick(1.0f / hz) {
+  simulation.buildFrameGraph(graph);
+  thread = std::thread([this] { loop(); });
+}
+
+SimulationThread::~SimulationThread() {
+  running = false;
+  thread.join();
+}
+
+float SimulationThread::tickDistance() const { return STAR_SPEED * tick; }
+
+void SimulationThread::loop() {
+  STARFIELD_TRACE_THREAD("simulation");
+  using clock = std::chrono::steady_clock;
+  const auto period = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(tick));
+  auto next = clock::now();
+  // the first snapshot only builds the instances of the initial state
+  int ticks = 0;
+
+  while (running) {
+    StarSnapshot &snapshot = snapshots.writeBuffer();
+    snapshot.instances.resize(simulation.size() * simulation.stride());
+    simulation.setUploadTarget(snapshot.instances.data());
+    simulation.setTicks(ticks, tickDistance());
+    {
+      STARFIELD_TRACE("simulate");
+      scheduler.run(graph);
+    }
+    snapshot.time =
+        std::chrono::duration<double>(next.time_since_epoch()).count();
+    snapshots.publish();
+
+    next += period;
+    std::this_thread::sleep_until(next);
+
+    auto now = clock::now();
+    ticks = 1;
+    while (next + period <= now) {
+      next += period;
+      if (++ticks == MAX_CATCH_UP) {
+        next = now;
+        break;
+      }
+    }
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "jobs.hh"
+#include "simulation.hh"
+#include "triplebuffer.hh"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Instances of one simulated tick, time is when that tick happened in
+// steadySeconds().
+struct StarSnapshot {
+  std::vector<unsigned char> instances; // StarSimulation::stride() per star
+  double time{0.0};
+};
+
+// Seconds on the clock shared by the simulation thread and the renderer.
+double steadySeconds();
+
+// Runs the star simulation at a fixed rate on its own thread, independent of
+// the render loop. Each tick's instances go into a triple buffer the render
+// thread picks the newest from without blocking.
+class SimulationThread {
+public:
+  SimulationThread(StarSimulation &simulation, JobScheduler &scheduler,
+                   float hz);
+  SimulationThread(const SimulationThread &) = delete;
+  SimulationThread &operator=(const SimulationThread &) = delete;
+  ~SimulationThread();
+
+  // Returns true when a newer snapshot than last time is available.
+  bool update() { return snapshots.update(); }
+  const StarSnapshot &latest() const { return snapshots.readBuffer(); }
+
+  float tickSeconds() const { return tick; }
+  float tickDistance() const;
+
+private:
+  void loop();
+
+  StarSimulation &simulation;
+  JobScheduler &scheduler;
+  JobGraph graph;
+  float tick;
+  TripleBuffer<StarSnapshot> snapshots;
+  std::atomic<bool> running{true};
+  std::thread thread;
+};
@@ -0,0 +1,141 @@
+#include "simulation.hh"
+#include "config.hh"
+#include "rng.hh"
+#include "trace.hh"
+#include <chrono>
+#include <cstring>
+
+Respawn starRespawn(uint32_t seed) {
+  return {streamKey(seed, STREAM_Z), -zFar, zFar + 100.0f};
+}
+
+float respawnLimit() { return zFar + 10.0f; }
+
+void respawnPosition(uint32_t seed, uint32_t index, uint32_t generation,
+                     float &x, float &y) {
+  x = counterUniform(streamKey(seed, STREAM_X), index, generation, 0.0f,
+                     (float)SCREEN_WIDTH);
+  y = counterUniform(streamKey(seed, STREAM_Y), index, generation, 0.0f,
+                     (float)SCREEN_HEIGHT);
+}
+
+StarSimulation::StarSimulation(uint32_t amount, SimdIsa isa, uint32_t seed,
+                               InstanceFormat format, bool depthRing)
+    : count(amount), seed(seed), field(generateStarOffsets(amount, seed)),
+      instanceFormat(format), instanceData(amount * instanceStride(format)),
+      respawned(amount), advance(selectAdvanceKernel(isa)),
+      respawn(starRespawn(seed)) {
+  if (depthRing) {
+    ring = std::make_unique<DepthRing>(std::move(field), seed, -zFar,
+                                       respawnLimit());
+  }
+}
+
+void StarSimulation::resize(size_t stars) {
+  if (ring)
+    return;
+  if (stars > field.size()) {
+    size_t placed = field.size();
+    field.resize(stars);
+    generateStars(field, placed, stars, seed);
+    instanceData.resize(stars * stride());
+    respawned.resize(stars);
+  }
+  count = stars;
+}
+
+template <typename Job> void StarSimulation::timed(Stage stage, Job job) {
+  static const char *const traceNames[STAGES] = {"update", "build instances",
+                                                 "copy instances"};
+  STARFIELD_TRACE(traceNames[stage]);
+  if (!stageTiming) {
+    job();
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  job();
+  auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  stageNanoseconds[stage].fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+StageTimes StarSimulation::takeStageTimes() {
+  auto take = [&](Stage stage) {
+    return stageNanoseconds[stage].exchange(0, std::memory_order_relaxed) /
+           1.0e6f;
+  };
+  StageTimes times;
+  times.updateMs = take(Update);
+  times.buildMs = take(Build);
+  times.copyMs = take(Copy);
+  return times;
+}
+
+void StarSimulation::buildFrameGraph(JobGraph &graph) {
+  respawnedChunks.resize((count + FRAME_CHUNK - 1) / FRAME_CHUNK);
+  size_t ringJob{0};
+  if (ring) {
+    ringJob = graph.add([this] { timed(Update, [&] { simulateRing(); }); });
+  }
+
+  for (size_t begin = 0; begin < count; begin += FRAME_CHUNK) {
+    size_t end = begin + FRAME_CHUNK < count ? begin + FRAME_CHUNK : count;
+    size_t simulateJob = ring ? ringJob : graph.add([this, begin, end] {
+      timed(Update, [&] { simulate(begin, end); });
+    });
+    size_t buildJob = graph.add([this, begin, end] {
+      timed(Build, [&] { buildInstances(begin, end); });
+    });
+    size_t copyJob = graph.add([this, begin, end] {
+      timed(Copy, [&] { copyInstances(begin, end); });
+    });
+    graph.precede(simulateJob, buildJob);
+    graph.precede(buildJob, copyJob);
+  }
+}
+
+void StarSimulation::simulate(size_t begin, size_t end) {
+  std::vector<uint32_t> &chunk = respawnedChunks[begin / FRAME_CHUNK];
+  chunk.clear();
+  for (int tick = 0; tick < ticks; ++tick) {
+    size_t respawns =
+        advance(field.z(), field.generation(), begin, end, step,
+                respawnLimit(), respawn, respawned.data() + begin);
+    // the kernels only redraw z, the few respawned stars get x/y here
+    for (size_t k = 0; k < respawns; ++k) {
+      uint32_t index = respawned[begin + k];
+      respawnPosition(seed, index, field.generation()[index],
+                      field.x()[index], field.y()[index]);
+      chunk.push_back(index);
+    }
+  }
+}
+
+void StarSimulation::simulateRing() {
+  for (int tick = 0; tick < ticks; ++tick) {
+    ring->advance(step);
+  }
+}
+
+void StarSimulation::buildInstances(size_t begin, size_t end) {
+  unsigned char *out = instanceData.data() + begin * stride();
+  if (ring) {
+    for (size_t index = begin; index < end; ++index) {
+      size_t slot = ring->slot(index);
+      packInstance(instanceFormat, ring->x(slot), ring->y(slot),
+                   ring->z(slot), out + (index - begin) * stride());
+    }
+    return;
+  }
+
+  packInstances(instanceFormat, field.x(), field.y(), field.z(), begin, end,
+                out);
+}
+
+void StarSimulation::copyInstances(size_t begin, size_t end) {
+  if (uploadTarget == nullptr)
+    return;
+  std::memcpy(uploadTarget + begin * stride(),
+              instanceData.data() + begin * stride(), (end - begin) * stride());
+}
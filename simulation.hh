@@ -0,0 +1,110 @@
+#pragma once
+#include "advance.hh"
+#include "depthring.hh"
+#include "instance.hh"
+#include "jobs.hh"
+#include "starfield.hh"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Stars handled by one job, a multiple of a cache line of floats. Small
+// enough that a frame has several chunks per thread to steal from.
+constexpr size_t FRAME_CHUNK = 16384;
+
+// Stars moving past respawnLimit() come back at a z from starRespawn(seed)
+// and an x/y from respawnPosition for their new generation. Anything else
+// simulating the same field has to use these too.
+Respawn starRespawn(uint32_t seed);
+float respawnLimit();
+void respawnPosition(uint32_t seed, uint32_t index, uint32_t generation,
+                     float &x, float &y);
+
+// Milliseconds the frame graph's jobs spent in each stage, summed over the
+// threads that ran them.
+struct StageTimes {
+  float updateMs{0.0f};
+  float buildMs{0.0f};
+  float copyMs{0.0f};
+};
+
+// CPU side of a frame split into per-chunk jobs:
+//   simulate ticks (advance z, respawn) -> build instances -> copy to upload
+//   buffer
+// With a depth ring the simulate step is a single job that only touches the
+// recycled stars, and instances come out sorted back to front.
+class StarSimulation {
+public:
+  StarSimulation(uint32_t amount, SimdIsa isa, uint32_t seed,
+                 InstanceFormat format, bool depthRing = false);
+
+  size_t size() const { return count; }
+  // Changes how many stars are simulated. Shrinking keeps the storage, the
+  // stars past the new size are frozen and come back as they were. Growing
+  // past anything seen before places new stars. Not supported with a depth
+  // ring. Rebuild the frame graph afterwards.
+  void resize(size_t stars);
+  bool resizable() const { return !ring; }
+  InstanceFormat format() const { return instanceFormat; }
+  size_t stride() const { return instanceStride(instanceFormat); }
+  // Instances built by the last frame graph run, stride() bytes per star.
+  const unsigned char *instances() const { return instanceData.data(); }
+  const StarField &stars() const { return field; }
+  // For putting back a saved state between runs; change the stars only
+  // while no frame graph runs.
+  StarField &stars() { return field; }
+  // Calls sink(index) for every star that respawned, and so got a new x/y,
+  // during the last frame graph run. Not with a depth ring.
+  template <typename Sink> void forEachRespawned(Sink sink) const {
+    for (const std::vector<uint32_t> &chunk : respawnedChunks) {
+      for (uint32_t index : chunk)
+        sink(index);
+    }
+  }
+
+  // Appends the jobs for one frame to graph, run it once per frame.
+  void buildFrameGraph(JobGraph &graph);
+  // Simulated ticks per frame graph run and the distance a star moves per
+  // tick. With zero ticks the jobs only rebuild the instances.
+  void setTicks(int ticks, float step) {
+    this->ticks = ticks;
+    this->step = step;
+  }
+  // Times every job of the frame graph while on, read the totals with
+  // takeStageTimes. The jobs read it unsynchronised, set it before any
+  // thread runs them.
+  void setStageTiming(bool on) { stageTiming = on; }
+  // Stage times since the last call.
+  StageTimes takeStageTimes();
+  // Mapped instance buffer the copy jobs write to, nullptr skips the copy.
+  void setUploadTarget(void *target) {
+    uploadTarget = static_cast<unsigned char *>(target);
+  }
+
+private:
+  void simulate(size_t begin, size_t end);
+  void simulateRing();
+  void buildInstances(size_t begin, size_t end);
+  void copyInstances(size_t begin, size_t end);
+  enum Stage { Update, Build, Copy, STAGES };
+  template <typename Job> void timed(Stage stage, Job job);
+
+  size_t count;
+  uint32_t seed;
+  StarField field;
+  std::unique_ptr<DepthRing> ring;
+  InstanceFormat instanceFormat;
+  std::vector<unsigned char> instanceData;
+  std::vector<uint32_t> respawned;
+  // respawned stars of the frame, per FRAME_CHUNK so each job has its own
+  std::vector<std::vector<uint32_t>> respawnedChunks;
+  AdvanceKernel advance;
+  Respawn respawn;
+  unsigned char *uploadTarget{nullptr};
+  int ticks{1};
+  float step{1.0f};
+  bool stageTiming{false};
+  std::atomic<uint64_t> stageNanoseconds[STAGES]{};
+};
@@ -0,0 +1,31 @@
+#include "starfield.hh"
+#include "config.hh"
+#include "rng.hh"
+
+void StarField::resize(size_t count) {
+  xs.resize(count);
+  ys.resize(count);
+  zs.resize(count);
+  gens.resize(count);
+  this->count = count;
+}
+
+void generateStars(StarField &stars, size_t begin, size_t end,
+                   uint32_t seed) {
+  size_t count = end - begin;
+  counterUniformBatch(streamKey(seed, STREAM_X), (uint32_t)begin, nullptr,
+                      0.0f, (float)SCREEN_WIDTH, stars.x() + begin, count);
+  counterUniformBatch(streamKey(seed, STREAM_Y), (uint32_t)begin, nullptr,
+                      0.0f, (float)SCREEN_HEIGHT, stars.y() + begin, count);
+  counterUniformBatch(streamKey(seed, STREAM_Z), (uint32_t)begin, nullptr,
+                      -zFar, 2.0f * zFar, stars.z() + begin, count);
+  for (size_t index = begin; index < end; ++index) {
+    stars.generation()[index] = 0;
+  }
+}
+
+StarField generateStarOffsets(uint32_t amount, uint32_t seed) {
+  StarField retVal(amount);
+  generateStars(retVal, 0, amount, seed);
+  return retVal;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+constexpr size_t CACHE_LINE = 64;
+
+// Heap array aligned to a cache line. The allocation is padded up to a whole
+// number of cache lines so vector code may read past size() in the last line.
+template <typename T> class AlignedArray {
+public:
+  AlignedArray() = default;
+  explicit AlignedArray(size_t count) { resize(count); }
+  AlignedArray(const AlignedArray &) = delete;
+  AlignedArray &operator=(const AlignedArray &) = delete;
+  AlignedArray(AlignedArray &&other) noexcept { swap(other); }
+  AlignedArray &operator=(AlignedArray &&other) noexcept {
+    swap(other);
+    return *this;
+  }
+  ~AlignedArray() { std::free(items); }
+
+  void resize(size_t count) {
+    size_t bytes = paddedBytes(count);
+    T *fresh = static_cast<T *>(std::aligned_alloc(CACHE_LINE, bytes));
+    if (fresh == nullptr) {
+      throw std::bad_alloc();
+    }
+    std::memset(static_cast<void *>(fresh), 0, bytes);
+    if (items != nullptr) {
+      std::memcpy(static_cast<void *>(fresh), items,
+                  (count < length ? count : length) * sizeof(T));
+      std::free(items);
+    }
+    items = fresh;
+    length = count;
+  }
+
+  size_t size() const { return length; }
+  T *data() { return items; }
+  const T *data() const { return items; }
+  T &operator[](size_t index) { return items[index]; }
+  const T &operator[](size_t index) const { return items[index]; }
+
+private:
+  static size_t paddedBytes(size_t count) {
+    size_t bytes = count * sizeof(T);
+    return bytes == 0 ? CACHE_LINE
+                      : (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+  }
+  void swap(AlignedArray &other) {
+    std::swap(items, other.items);
+    std::swap(length, other.length);
+  }
+
+  T *items{nullptr};
+  size_t length{0};
+};
+
+// Star state as a structure of arrays so each pass only streams the
+// components it actually touches (the per-frame advance only needs z).
+class StarField {
+public:
+  StarField() = default;
+  explicit StarField(size_t count) { resize(count); }
+
+  void resize(size_t count);
+  size_t size() const { return count; }
+
+  float *x() { return xs.data(); }
+  float *y() { return ys.data(); }
+  float *z() { return zs.data(); }
+  const float *x() const { return xs.data(); }
+  const float *y() const { return ys.data(); }
+  const float *z() const { return zs.data(); }
+  // How often each star has respawned, part of its random number counter.
+  uint32_t *generation() { return gens.data(); }
+  const uint32_t *generation() const { return gens.data(); }
+
+private:
+  size_t count{0};
+  AlignedArray<float> xs;
+  AlignedArray<float> ys;
+  AlignedArray<float> zs;
+  AlignedArray<uint32_t> gens;
+};
+
+// Same seed, same stars: positions come from the counter RNG in rng.hh.
+StarField generateStarOffsets(uint32_t amount, uint32_t seed);
+// Places stars [begin, end) of an already sized field the same way.
+void generateStars(StarField &stars, size_t begin, size_t end, uint32_t seed);
@@ -0,0 +1,91 @@
+// clang-format off
+#include "khrplatform.h"
+#include "glad.h"
+// clang-format on
+#include "stateless.hh"
+#include "config.hh"
+#include "rng.hh"
+#include <cmath>
+
+static float zMin() { return -zFar; }
+static float depth() { return 2.0f * zFar + 10.0f; }
+
+StatelessClock statelessClock(double seconds) {
+  double travelled = seconds * STAR_SPEED;
+  double cycles = std::floor(travelled / depth());
+  return {(uint32_t)cycles, (float)(travelled - cycles * depth())};
+}
+
+glm::vec3 statelessPosition(uint32_t seed, uint32_t index,
+                            const StatelessClock &clock) {
+  float along = counterUniform(streamKey(seed, STREAM_Z), index, 0, 0.0f,
+                               depth()) +
+                clock.travel;
+  uint32_t wrapped = along >= depth() ? 1 : 0;
+  uint32_t generation = clock.cycles + wrapped;
+
+  return glm::vec3(counterUniform(streamKey(seed, STREAM_X), index,
+                                  generation, 0.0f, (float)SCREEN_WIDTH),
+                   counterUniform(streamKey(seed, STREAM_Y), index,
+                                  generation, 0.0f, (float)SCREEN_HEIGHT),
+                   zMin() + along - (float)wrapped * depth());
+}
+
+// mix32/counterRandom/counterUniform must match rng.hh bit for bit
+const char *const statelessVertexShaderSource = R"(
+#version 330 core
+uniform uvec3 u_keys;
+uniform uint u_cycles;
+uniform float u_travel;
+uniform vec4 u_field; // zMin, depth, width, height
+uniform float u_streakZ;
+
+uint mix32(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float counterUniform(uint key, uint index, uint generation, float lo, float range)
+{
+    uint bits = mix32(mix32(index + key) ^ (generation * 0x9e3779b9u));
+    return lo + float(bits >> 8) * (1.0 / 16777216.0) * range;
+}
+
+void placeStar(vec3 offset, float scale);
+
+void main()
+{
+    uint index = uint(gl_InstanceID);
+    float along = counterUniform(u_keys.z, index, 0u, 0.0, u_field.y) + u_travel;
+    uint wrapped = along >= u_field.y ? 1u : 0u;
+    uint generation = u_cycles + wrapped;
+
+    vec3 offset = vec3(counterUniform(u_keys.x, index, generation, 0.0, u_field.z),
+                       counterUniform(u_keys.y, index, generation, 0.0, u_field.w),
+                       u_field.x + along - float(wrapped) * u_field.y);
+    placeStar(offset, offset.z > u_streakZ ? 0.1 : 1.0);
+}
+)";
+
+void setStatelessUniforms(uint32_t program, uint32_t seed,
+                          const StatelessClock &clock) {
+  glUniform3ui(glGetUniformLocation(program, "u_keys"),
+               streamKey(seed, STREAM_X), streamKey(seed, STREAM_Y),
+               streamKey(seed, STREAM_Z));
+  glUniform1ui(glGetUniformLocation(program, "u_cycles"), clock.cycles);
+  glUniform1f(glGetUniformLocation(program, "u_travel"), clock.travel);
+  glUniform4f(glGetUniformLocation(program, "u_field"), zMin(), depth(),
+              (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT);
+  glUniform1f(glGetUniformLocation(program, "u_streakZ"), zFar / 2.0f);
+}
+
+void setStatelessClock(const UniformCache &uniforms,
+                       const StatelessClock &clock) {
+  glUniform1ui(uniforms["u_cycles"], clock.cycles);
+  glUniform1f(uniforms["u_travel"], clock.travel);
+}
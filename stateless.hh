@@ -0,0 +1,33 @@
+#pragma once
+#include "glstate.hh"
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Stateless starfield: a star's position is a closed-form function of its
+// index, the seed and the time, so nothing per star is stored or updated.
+// Each star starts at a random phase along z and travels at STAR_SPEED.
+// When it passes the far end it wraps back by the full depth of the field,
+// and its wrap count becomes the generation that picks the new x and y.
+
+// Distance travelled since start, split so it stays exact however long we
+// run: whole trips through the field plus what is left over.
+struct StatelessClock {
+  uint32_t cycles;
+  float travel;
+};
+
+StatelessClock statelessClock(double seconds);
+
+// CPU version of what the stateless vertex shader computes.
+glm::vec3 statelessPosition(uint32_t seed, uint32_t index,
+                            const StatelessClock &clock);
+
+// Vertex shader that positions gl_InstanceID with statelessPosition, set its
+// uniforms with setStatelessUniforms. Append drawModeVertexSource to it.
+extern const char *const statelessVertexShaderSource;
+
+void setStatelessUniforms(uint32_t program, uint32_t seed,
+                          const StatelessClock &clock);
+// Only the clock uniforms, the part that changes from frame to frame.
+void setStatelessClock(const UniformCache &uniforms,
+                       const StatelessClock &clock);
@@ -0,0 +1,31 @@
+#pragma once
+
+// Turns variable frame times into a whole number of fixed simulation ticks.
+// Whatever is left over is reported as alpha so rendering can interpolate
+// between the last two simulated states.
+class FixedTimestep {
+public:
+  // Frames longer than this (breakpoints, window drags) are not caught up on.
+  static constexpr float MAX_FRAME_TIME = 0.25f;
+
+  explicit FixedTimestep(float hz) : tick(1.0f / hz) {}
+
+  // Returns how many ticks to simulate for a frame that took frameTime.
+  int advance(float frameTime) {
+    accumulator += frameTime < MAX_FRAME_TIME ? frameTime : MAX_FRAME_TIME;
+    int ticks{0};
+    while (accumulator >= tick) {
+      accumulator -= tick;
+      ticks++;
+    }
+    return ticks;
+  }
+
+  // Fraction of a tick between the last simulated state and now, 0..1.
+  float alpha() const { return accumulator / tick; }
+  float seconds() const { return tick; }
+
+private:
+  float tick;
+  float accumulator{0.0f};
+};
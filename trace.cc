@@ -0,0 +1,166 @@
+#include "trace.hh"
+#include <atomic>
+#include <csignal>
+#include <fstream>
+
+static std::atomic<bool> requested{false};
+
+static void requestTrace(int) { requested.store(true); }
+
+void installTraceSignal() {
+#ifdef SIGUSR1
+  std::signal(SIGUSR1, requestTrace);
+#endif
+}
+
+bool traceRequested() { return requested.exchange(false); }
+
+#ifndef STARFIELD_TRACING
+
+bool tracingEnabled() { return false; }
+
+bool writeTrace(const char *) { return false; }
+
+#else
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Fields are atomics so a writeTrace racing the owning thread is defined,
+// the ring's two counters work as a seqlock telling it which of the events
+// it read may have been overwritten meanwhile. Relaxed stores and the
+// fences are plain stores and nothing on x86.
+struct TraceEvent {
+  std::atomic<const char *> name{nullptr};
+  std::atomic<uint64_t> start{0};
+  std::atomic<uint64_t> end{0};
+};
+
+struct TraceRing {
+  // events recorded so far, event n lives at n % TRACE_RING_EVENTS
+  std::atomic<uint64_t> head{0};
+  // events whose writing has begun, head or head + 1
+  std::atomic<uint64_t> claimed{0};
+  std::atomic<const char *> name{nullptr};
+  TraceEvent events[TRACE_RING_EVENTS];
+};
+
+static_assert((TRACE_RING_EVENTS & (TRACE_RING_EVENTS - 1)) == 0,
+              "TRACE_RING_EVENTS must be a power of two");
+
+// rings are never freed, a thread's events outlive it
+static std::mutex ringsMutex;
+static std::vector<std::unique_ptr<TraceRing>> rings;
+
+static const std::chrono::steady_clock::time_point epoch =
+    std::chrono::steady_clock::now();
+
+// the only lock a thread takes, once, on its first event
+static TraceRing &threadRing() {
+  thread_local TraceRing *ring = nullptr;
+  if (ring == nullptr) {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    rings.push_back(std::make_unique<TraceRing>());
+    ring = rings.back().get();
+  }
+  return *ring;
+}
+
+static void writeString(std::ostream &out, const char *text) {
+  out << '"';
+  for (; *text; ++text) {
+    if (*text == '"' || *text == '\\')
+      out << '\\';
+    out << *text;
+  }
+  out << '"';
+}
+
+bool tracingEnabled() { return true; }
+
+uint64_t traceNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch)
+      .count();
+}
+
+void traceRecord(const char *name, uint64_t start, uint64_t end) {
+  TraceRing &ring = threadRing();
+  uint64_t at = ring.head.load(std::memory_order_relaxed);
+  // a reader that sees any of the stores below also sees the claim
+  ring.claimed.store(at + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  TraceEvent &event = ring.events[at & (TRACE_RING_EVENTS - 1)];
+  event.name.store(name, std::memory_order_relaxed);
+  event.start.store(start, std::memory_order_relaxed);
+  event.end.store(end, std::memory_order_relaxed);
+  ring.head.store(at + 1, std::memory_order_release);
+}
+
+void traceThreadName(const char *name) {
+  threadRing().name.store(name, std::memory_order_relaxed);
+}
+
+bool writeTrace(const char *path) {
+  std::ofstream out(path);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  auto separate = [&] {
+    if (!first)
+      out << ',';
+    first = false;
+  };
+
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  for (size_t tid = 0; tid < rings.size(); ++tid) {
+    TraceRing &ring = *rings[tid];
+    if (const char *name = ring.name.load(std::memory_order_relaxed)) {
+      separate();
+      out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+          << tid << ",\"args\":{\"name\":";
+      writeString(out, name);
+      out << "}}";
+    }
+
+    // copy first, the owner may lap us while we read; whatever it had begun
+    // to overwrite by the time the copy is done gets dropped
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    uint64_t oldest = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+    struct Copy {
+      const char *name;
+      uint64_t start, end;
+    };
+    std::vector<Copy> copies;
+    copies.reserve(head - oldest);
+    for (uint64_t at = oldest; at < head; ++at) {
+      const TraceEvent &event = ring.events[at & (TRACE_RING_EVENTS - 1)];
+      copies.push_back({event.name.load(std::memory_order_relaxed),
+                        event.start.load(std::memory_order_relaxed),
+                        event.end.load(std::memory_order_relaxed)});
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t claimed = ring.claimed.load(std::memory_order_relaxed);
+    uint64_t valid =
+        claimed > TRACE_RING_EVENTS ? claimed - TRACE_RING_EVENTS : 0;
+
+    for (uint64_t at = std::max(oldest, valid); at < head; ++at) {
+      const Copy &event = copies[at - oldest];
+      char times[64];
+      std::snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f",
+                    event.start / 1000.0, (event.end - event.start) / 1000.0);
+      separate();
+      out << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ',' << times
+          << ",\"name\":";
+      writeString(out, event.name);
+      out << '}';
+    }
+  }
+  out << "]}" << std::endl;
+  return (bool)out;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+// Timeline of what every thread was doing, for chrome://tracing or
+// ui.perfetto.dev. Configure with -DSTARFIELD_TRACING=ON, then
+//   STARFIELD_TRACE("draw");
+// records the rest of the enclosing scope as a complete event on the calling
+// thread. Each thread writes its own ring of the latest TRACE_RING_EVENTS
+// events without locks, writeTrace exports all of them. Without
+// STARFIELD_TRACING the macros are empty and nothing is recorded.
+
+// Events kept per thread, older ones are overwritten.
+constexpr unsigned TRACE_RING_EVENTS = 1u << 15;
+
+#ifdef STARFIELD_TRACING
+#include <cstdint>
+
+uint64_t traceNow();
+// name has to outlive the trace, a string literal.
+void traceRecord(const char *name, uint64_t start, uint64_t end);
+void traceThreadName(const char *name);
+
+class TraceScope {
+public:
+  explicit TraceScope(const char *name) : name(name), start(traceNow()) {}
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+  ~TraceScope() { traceRecord(name, start, traceNow()); }
+
+private:
+  const char *name;
+  uint64_t start;
+};
+
+#define STARFIELD_TRACE_JOIN2(a, b) a##b
+#define STARFIELD_TRACE_JOIN(a, b) STARFIELD_TRACE_JOIN2(a, b)
+#define STARFIELD_TRACE(name)                                                  \
+  TraceScope STARFIELD_TRACE_JOIN(traceScope, __LINE__)(name)
+// Names the calling thread's row in the timeline.
+#define STARFIELD_TRACE_THREAD(name) traceThreadName(name)
+#else
+// unevaluated, only so names made for tracing do not count as unused
+#define STARFIELD_TRACE(name) ((void)sizeof(name))
+#define STARFIELD_TRACE_THREAD(name) ((void)sizeof(name))
+#endif
+
+// Whether this build records anything.
+bool tracingEnabled();
+// Writes every thread's events as Chrome trace event JSON, false if the file
+// could not be written. Threads may keep recording meanwhile.
+bool writeTrace(const char *path);
+// Makes SIGUSR1 ask for a trace, see traceRequested.
+void installTraceSignal();
+// True once per SIGUSR1 received, the handler itself cannot write files.
+bool traceRequested();
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Single producer, single consumer hand-off of the latest value. The writer
+// fills its own slot and publishes it, the reader swaps in whatever slot was
+// published last. Neither side ever waits on the other, a slow reader just
+// skips values.
+template <typename T> class TripleBuffer {
+public:
+  // Writer side: the slot to fill, then publish it.
+  T &writeBuffer() { return slots[back].value; }
+  void publish() {
+    uint8_t previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+    back = previous & INDEX;
+  }
+
+  // Reader side: returns false when nothing new was published since the last
+  // call, readBuffer then still holds the previous value.
+  bool update() {
+    if ((middle.load(std::memory_order_acquire) & FRESH) == 0)
+      return false;
+    uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+    front = previous & INDEX;
+    return true;
+  }
+  const T &readBuffer() const { return slots[front].value; }
+
+private:
+  static constexpr uint8_t INDEX = 3;
+  static constexpr uint8_t FRESH = 4;
+
+  struct alignas(64) Slot {
+    T value;
+  };
+
+  Slot slots[3];
+  alignas(64) uint8_t back{0};
+  alignas(64) std::atomic<uint8_t> middle{1};
+  alignas(64) uint8_t front{2};
+};
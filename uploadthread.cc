@@ -0,0 +1,152 @@
+// clang-format off
+#include "khrplatform.h"
+#include "glad.h"
+// clang-format on
+#include "uploadthread.hh"
+#include "trace.hh"
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <iostream>
+
+constexpr GLuint64 FENCE_TIMEOUT = 1000000000; // ns, only to log stalls
+
+static void waitAndDelete(void *&sync) {
+  GLsync fence = static_cast<GLsync>(sync);
+  if (fence == nullptr)
+    return;
+  GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  while (status == GL_TIMEOUT_EXPIRED) {
+    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+    if (status == GL_TIMEOUT_EXPIRED)
+      std::cerr << "Error waiting on a drawn instance buffer" << std::endl;
+  }
+  glDeleteSync(fence);
+  sync = nullptr;
+}
+
+static void deleteSync(void *&sync) {
+  if (sync != nullptr)
+    glDeleteSync(static_cast<GLsync>(sync));
+  sync = nullptr;
+}
+
+UploadThread::UploadThread(GLFWwindow *shared, SimulationThread &simulation)
+    : simulation(simulation) {
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  window = glfwCreateWindow(1, 1, "upload", nullptr, shared);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+  if (!window) {
+    std::cerr << "Error could not create the upload context" << std::endl;
+    exit(1);
+  }
+  for (Slot &slot : slots)
+    glGenBuffers(1, &slot.name);
+  thread = std::thread([this] { loop(); });
+}
+
+UploadThread::~UploadThread() {
+  running = false;
+  freed.notify_all();
+  thread.join();
+  for (Slot &slot : slots) {
+    deleteSync(slot.uploaded);
+    deleteSync(slot.drawn);
+    glDeleteBuffers(1, &slot.name);
+  }
+  glfwDestroyWindow(window);
+}
+
+bool UploadThread::acquire() {
+  int ready = -1;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int index = 0; index < SLOTS; ++index) {
+      if (slots[index].state == State::Ready)
+        ready = index;
+    }
+    if (ready < 0)
+      return false;
+    // the old buffer keeps the fence of its last draw for the upload thread
+    // to wait on
+    if (current >= 0)
+      slots[current].state = State::Free;
+    slots[ready].state = State::Drawing;
+    current = ready;
+  }
+  freed.notify_one();
+  Slot &slot = slots[current];
+  glWaitSync(static_cast<GLsync>(slot.uploaded), 0, GL_TIMEOUT_IGNORED);
+  deleteSync(slot.uploaded);
+  return true;
+}
+
+void UploadThread::fence() {
+  if (current < 0)
+    return;
+  Slot &slot = slots[current];
+  deleteSync(slot.drawn);
+  slot.drawn = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // the upload context can only flush its own commands
+  glFlush();
+}
+
+int UploadThread::takeFreeSlot() {
+  std::unique_lock<std::mutex> lock(mutex);
+  int index = -1;
+  freed.wait(lock, [&] {
+    for (index = 0; index < SLOTS; ++index) {
+      if (slots[index].state == State::Free)
+        return true;
+    }
+    index = -1;
+    return !running;
+  });
+  if (index >= 0)
+    slots[index].state = State::Filling;
+  return index;
+}
+
+void UploadThread::upload(Slot &slot, const StarSnapshot &snapshot) {
+  STARFIELD_TRACE("upload");
+  waitAndDelete(slot.drawn);
+  const std::vector<unsigned char> &instances = snapshot.instances;
+  glBindBuffer(GL_ARRAY_BUFFER, slot.name);
+  if (instances.size() > slot.capacity) {
+    glBufferData(GL_ARRAY_BUFFER, instances.size(), instances.data(),
+                 GL_STREAM_DRAW);
+    slot.capacity = instances.size();
+  } else {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size(), instances.data());
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  slot.time = snapshot.time;
+  slot.uploaded = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // a fence only signals once it reaches the GPU, nothing else flushes here
+  glFlush();
+}
+
+void UploadThread::loop() {
+  STARFIELD_TRACE_THREAD("upload");
+  glfwMakeContextCurrent(window);
+  while (running) {
+    if (!simulation.update()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    int index = takeFreeSlot();
+    if (index < 0)
+      break;
+    upload(slots[index], simulation.latest());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // a snapshot the render thread never picked up is stale now
+    for (Slot &slot : slots) {
+      if (slot.state == State::Ready) {
+        deleteSync(slot.uploaded);
+        slot.state = State::Free;
+      }
+    }
+    slots[index].state = State::Ready;
+  }
+  glfwMakeContextCurrent(nullptr);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "simthread.hh"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+struct GLFWwindow;
+
+// Uploads the simulation thread's snapshots on a thread of its own, through
+// a hidden window whose context shares buffers and fences with the render
+// context. Each snapshot goes into one of SLOTS buffers and is handed over
+// with a fence the render thread makes the GPU wait on instead of the CPU,
+// so copying instances overlaps drawing and swapping. A buffer is only
+// refilled once the draws that read it have finished.
+//
+// Takes over reading snapshots from the simulation thread, use time() here
+// rather than SimulationThread::latest().
+class UploadThread {
+public:
+  static constexpr int SLOTS = 3;
+
+  // Call on the render thread, with shared current.
+  UploadThread(GLFWwindow *shared, SimulationThread &simulation);
+  UploadThread(const UploadThread &) = delete;
+  UploadThread &operator=(const UploadThread &) = delete;
+  ~UploadThread();
+
+  // Switches to the newest uploaded snapshot and returns true when there is
+  // one newer than buffer(). Makes the GPU wait for its upload.
+  bool acquire();
+  // Call after the draw that read buffer().
+  void fence();
+
+  // Buffer of the current snapshot's instances, 0 before the first.
+  uint32_t buffer() const { return current < 0 ? 0 : slots[current].name; }
+  double time() const { return current < 0 ? 0.0 : slots[current].time; }
+
+private:
+  enum class State {
+    Free,    // may be refilled once drawn has passed
+    Filling, // upload thread is copying into it
+    Ready,   // uploaded, waiting for the render thread
+    Drawing  // the render thread's current buffer
+  };
+  struct Slot {
+    uint32_t name{0};
+    size_t capacity{0};
+    double time{0.0};
+    void *uploaded{nullptr}; // GLsync after the upload
+    void *drawn{nullptr};    // GLsync after the last draw reading it
+    State state{State::Free};
+  };
+
+  void loop();
+  int takeFreeSlot();
+  void upload(Slot &slot, const StarSnapshot &snapshot);
+
+  GLFWwindow *window;
+  SimulationThread &simulation;
+  Slot slots[SLOTS];
+  int current{-1};
+  std::mutex mutex;
+  std::condition_variable freed;
+  std::atomic<bool> running{true};
+  std::thread thread;
+};